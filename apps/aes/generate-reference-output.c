@@ -21,36 +21,39 @@ u8 key[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
             0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
 
 void dump_block(u8 *ptr) {
+    printf("{");
     for (int i = 0; i < AES_BLOCK_SIZE; i++) {
-        printf("0x%02x, ", *ptr);
-        ptr += AES_BLOCK_SIZE;
+        printf("0x%02x, ", ptr[i]);
     }
-    printf("\n");
+    printf("},\n");
 }
 
 int main(int argc, char **argv) {
-    // AES128 in Cipher Block Chaining mode
-    u8 *prevBlock;
-    u8 *ptr = input;
-
-    // Encrypt first block
-    aes_encrypt(ptr, key);
-    dump_block(ptr);
-    prevBlock = ptr;
-    ptr += AES_BLOCK_SIZE;
-
-    // Encrypt remaining blocks
-    while (ptr < input + sizeof(input)) {
-        // CBC - Cipher Block Chaining mode
-        for (int i = 0; i < AES_BLOCK_SIZE; i++) {
-            ptr[i] = ptr[i] ^ prevBlock[i];
-        }
-
-        // Encrypt current block
+    // The app encrypts the input in place, 3 times. Print the last block
+    // after each pass, as checked by verify_benchmark().
+    for (int pass = 0; pass < 3; pass++) {
+        // AES128 in Cipher Block Chaining mode
+        u8 *prevBlock;
+        u8 *ptr = input;
+
+        // Encrypt first block
         aes_encrypt(ptr, key);
-        dump_block(ptr);
-
         prevBlock = ptr;
         ptr += AES_BLOCK_SIZE;
+
+        // Encrypt remaining blocks
+        while (ptr < input + sizeof(input)) {
+            // CBC - Cipher Block Chaining mode
+            for (int i = 0; i < AES_BLOCK_SIZE; i++) {
+                ptr[i] = ptr[i] ^ prevBlock[i];
+            }
+
+            // Encrypt current block
+            aes_encrypt(ptr, key);
+
+            prevBlock = ptr;
+            ptr += AES_BLOCK_SIZE;
+        }
+        dump_block(prevBlock);
     }
 }
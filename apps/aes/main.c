@@ -8,16 +8,39 @@
 #include "TI_aes_128_encr_only.h"
 #include "lib/iclib/ic.h"
 #include "lib/support/support.h"
+#include <string.h>
 
 #define AES_BLOCK_SIZE (16u) // bytes
 
 #include "lipsum.h" // Input string
 
-static unsigned char key[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
-                              0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+static unsigned char key[] SRAM_HOT = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+                                       0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d,
+                                       0x0e, 0x0f};
+
+// Last block after each pass, see reference-output.txt
+static const uint8_t reference[3][AES_BLOCK_SIZE] = {
+    {0x53, 0x34, 0xab, 0xd4, 0x48, 0x0a, 0x7f, 0x48,
+     0xc6, 0xd1, 0x66, 0x4c, 0x33, 0xb5, 0x51, 0xfb},
+    {0x5c, 0x37, 0x41, 0x83, 0x72, 0xac, 0x77, 0x10,
+     0xc2, 0x9b, 0x17, 0xf4, 0x05, 0xd7, 0x9d, 0x81},
+    {0x39, 0x40, 0xe0, 0xbc, 0x86, 0xf4, 0xdc, 0x8c,
+     0x50, 0xb0, 0xa9, 0x29, 0xa8, 0x35, 0x49, 0xed}};
 
 /* ------ Function Declarations ---------------------------------------------*/
 
+/**
+ * @brief Check the last (chained) block against the reference
+ * @param result pass, the input is encrypted in place
+ */
+int verify_benchmark(int result) {
+  uint8_t *last = input + sizeof(input) - AES_BLOCK_SIZE;
+  mm_acquire_array(last, AES_BLOCK_SIZE, MM_READONLY);
+  int fail = memcmp(last, reference[result], AES_BLOCK_SIZE) != 0;
+  mm_release_array(last, AES_BLOCK_SIZE);
+  return fail;
+}
+
 void main(void) {
   for (volatile unsigned i = 0; i < 3; i++) {
     indicate_workload_begin();
@@ -55,6 +78,9 @@ void main(void) {
     mm_release_array(prevBlock, AES_BLOCK_SIZE);
 
     indicate_workload_end();
+    if (verify_benchmark(i) != 0) {
+      indicate_test_fail();
+    }
     mm_flush();
 
     // Delay
@@ -12,6 +12,7 @@
 #include "crc.h"
 
 #define MMDATA
+#define FRAM_DIRECT
 #include "lipsum.h"
 
 typedef unsigned char u8;
@@ -8,7 +8,7 @@
 #include <stdint.h>
 #include "lib/iclib/ic.h"
 
-char input[2048] MMDATA =
+char input[2048] FRAM_DIRECT =
     "Lorem ipsum dolor sit amet, consectetuer adipiscing elit. Aenean commodo "
     "ligula eget dolor. Aenean massa. Cum sociis natoque penatibus et magnis "
     "dis parturient montes, nascetur ridiculus mus. Donec quam felis, "
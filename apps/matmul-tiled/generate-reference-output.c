@@ -47,4 +47,13 @@ void main(void) {
     }
     printf("\n");
   }
+
+  // Checksum of the output, as computed by verify_benchmark()
+  uint32_t sum = 0;
+  for (int i = 0; i < MATSIZE; i++) {
+    for (int j = 0; j < MATSIZE; j++) {
+      sum = sum * 31 + (uint16_t)output[i][j];
+    }
+  }
+  printf("checksum: 0x%08x\n", (unsigned)sum);
 }
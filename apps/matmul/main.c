@@ -20,26 +20,46 @@ void matmult(int m, int n, int16_t a[m][n], int16_t b[m][n],
   uint8_t i, j, k;
 
   for (i = 0; i < m; ++i) {
-    mm_acquire_array((uint8_t *)&out[i][0], sizeof(int) * n, MM_READWRITE);
-    mm_acquire_array((uint8_t *)&a[i][0], sizeof(int) * m, MM_READWRITE);
+    mm_acquire_array((uint8_t *)&out[i][0], sizeof(out[i][0]) * n,
+                     MM_READWRITE);
+    mm_acquire_array((uint8_t *)&a[i][0], sizeof(a[i][0]) * m, MM_READWRITE);
     for (j = 0; j < n; ++j) {
       out[i][j] = 0;
       for (k = 0; k < m; ++k) {
-        mm_acquire_array((uint8_t *)&b[k][j], sizeof(int), MM_READWRITE);
+        mm_acquire_array((uint8_t *)&b[k][j], sizeof(b[k][j]), MM_READWRITE);
         out[i][j] += a[i][k] * b[k][j];
-        mm_release_array((uint8_t *)&b[k][j], sizeof(int));
+        mm_release_array((uint8_t *)&b[k][j], sizeof(b[k][j]));
       }
     }
-    mm_release_array((uint8_t *)&out[i][0], sizeof(int) * n);
-    mm_release_array((uint8_t *)&a[i][0], sizeof(int) * m);
+    mm_release_array((uint8_t *)&out[i][0], sizeof(out[i][0]) * n);
+    mm_release_array((uint8_t *)&a[i][0], sizeof(a[i][0]) * m);
   }
 }
 
+// See reference-output.txt
+#define REFERENCE_CHECKSUM 0x13fd1400
+
+int verify_benchmark(int result) {
+  uint32_t sum = 0;
+  (void)result;
+  for (int i = 0; i < MATSIZE; ++i) {
+    mm_acquire_array((uint8_t *)&output[i][0], sizeof(output[i]), MM_READONLY);
+    for (int j = 0; j < MATSIZE; ++j) {
+      sum = sum * 31 + (uint16_t)output[i][j];
+    }
+    mm_release_array((uint8_t *)&output[i][0], sizeof(output[i]));
+  }
+  return sum == REFERENCE_CHECKSUM ? 0 : 1;
+}
+
 void main(void) {
   for (volatile unsigned i = 0; i < 3; ++i) {
     indicate_workload_begin();
     matmult(MATSIZE, MATSIZE, a, b, output);
     indicate_workload_end();
+    if (verify_benchmark(0) != 0) {
+      indicate_test_fail();
+    }
     mm_flush();
     wait();
   }
@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2019-2020, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Microbenchmarks of the memory manager API. Each call is timed with the
+ * cycle counter (ns on the host), and the bytes moved to and from NVM are
+ * taken from the MM_STATS counters, over a sweep of access patterns, working
+ * set sizes and read/write mixes. Built once per PAGE_SIZE/MAX_DIRTY_PAGES
+ * configuration (ICLIB_MM_BENCH_CONFIGS), see lib/support/run-mm-bench.py.
+ */
+
+#include "lib/iclib/ic.h"
+#include "lib/iclib/memory-management.h"
+#include "lib/support/support.h"
+#ifdef HOST_ARCH
+#include <stdio.h>
+#endif
+
+/* ------ Parameters ------ */
+#define ARENA_SIZE 4096u
+#define ARENA_PAGES (ARENA_SIZE / PAGE_SIZE)
+#define ELEMENT_SIZE 16 // Bytes per access
+#define CALLS 64        // Timed calls per pattern
+
+/* ------ Types ------ */
+typedef enum {
+  API_ACQUIRE,
+  API_RELEASE,
+  API_ACQUIRE_ARRAY,
+  API_RELEASE_ARRAY,
+  API_ACQUIRE_PAGE,
+  API_FLUSH,
+  API_RESTORE,
+  N_APIS
+} api_t;
+
+typedef enum { SEQ, STRIDED, RANDOM, TILED, N_PATTERNS } pattern_t;
+
+typedef struct {
+  uint8_t api;
+  uint8_t pattern;
+  uint8_t pages;     //! Working set [pages]
+  uint8_t write_pct; //! Share of MM_READWRITE accesses
+  uint16_t calls;
+  uint32_t cycles; //! Total, less the timer overhead
+  uint32_t bytes;  //! Loaded from and written to NVM
+  uint32_t threshold_updates;
+} result_t;
+
+static const char *const api_names[N_APIS] = {
+    "acquire",      "release", "acquire_array", "release_array",
+    "acquire_page", "flush",   "restore"};
+static const char *const pattern_names[N_PATTERNS] = {"seq", "strided",
+                                                      "random", "tiled"};
+static const uint8_t ws_pages[] = {4, 8, 16};
+static const uint8_t write_pcts[] = {0, 50, 100};
+
+#define N_WS (sizeof(ws_pages) / sizeof(ws_pages[0]))
+#define N_MIXES (sizeof(write_pcts) / sizeof(write_pcts[0]))
+#define N_RESULTS (4 * N_PATTERNS * N_WS * N_MIXES + 2 * N_WS * N_MIXES + N_WS)
+
+/* ------ Globals ------ */
+static uint8_t arena[ARENA_SIZE] MMDATA;
+
+// Read out with a debugger on devices without a console
+static result_t results[N_RESULTS] PERSISTENT;
+static unsigned n_results PERSISTENT;
+
+static uint32_t timer_overhead; // Cycles of an empty start/read pair
+
+/* ------ Function prototypes ------ */
+static unsigned offset(pattern_t pattern, unsigned i, unsigned ws_bytes);
+static mm_mode mode(unsigned i, uint8_t write_pct);
+static void cold(void);
+static result_t *record(api_t api, pattern_t pattern, uint8_t pages,
+                        uint8_t write_pct);
+static void account(result_t *r, uint32_t cycles, mm_stats_t before);
+static void bench_pattern(pattern_t pattern, uint8_t pages,
+                          uint8_t write_pct);
+static void bench_acquire_page(uint8_t pages, uint8_t write_pct);
+static void bench_flush(uint8_t pages, uint8_t write_pct);
+static void bench_restore(uint8_t pages);
+
+/* ------ Function definitions ------ */
+
+int verify_benchmark(int result) {
+  (void)result;
+  return -1; // Nothing to verify
+}
+
+void main(void) {
+  // Calibrate the timer overhead, keep the smallest of a few reads
+  timer_overhead = UINT32_MAX;
+  for (volatile unsigned i = 0; i < 16; ++i) {
+    cycle_counter_start();
+    uint32_t t = cycle_counter_read();
+    if (t < timer_overhead) {
+      timer_overhead = t;
+    }
+  }
+
+  n_results = 0;
+  indicate_workload_begin();
+  for (unsigned w = 0; w < N_WS; ++w) {
+    uint8_t pages = ws_pages[w];
+    if (pages > ARENA_PAGES) {
+      continue;
+    }
+    for (unsigned m = 0; m < N_MIXES; ++m) {
+      for (pattern_t p = SEQ; p < N_PATTERNS; ++p) {
+        bench_pattern(p, pages, write_pcts[m]);
+      }
+      bench_acquire_page(pages, write_pcts[m]);
+      bench_flush(pages, write_pcts[m]);
+    }
+    bench_restore(pages);
+  }
+  indicate_workload_end();
+
+#ifdef HOST_ARCH
+  for (unsigned i = 0; i < n_results; ++i) {
+    const result_t *r = &results[i];
+    printf("mm-bench: page_size=%u max_dirty=%u api=%s pattern=%s pages=%u "
+           "write_pct=%u calls=%u cycles=%lu bytes=%lu "
+           "threshold_updates=%lu\n",
+           PAGE_SIZE, MAX_DIRTY_PAGES, api_names[r->api],
+           pattern_names[r->pattern], r->pages, r->write_pct, r->calls,
+           (unsigned long)r->cycles, (unsigned long)r->bytes,
+           (unsigned long)r->threshold_updates);
+  }
+#else
+  (void)api_names;
+  (void)pattern_names;
+#endif
+
+  end_experiment();
+}
+
+/**
+ * @brief Byte offset of the i-th access of a pattern
+ * @param pattern access pattern
+ * @param i access number
+ * @param ws_bytes working set, a multiple of PAGE_SIZE
+ * @return offset into the arena, ELEMENT_SIZE aligned
+ */
+static unsigned offset(pattern_t pattern, unsigned i, unsigned ws_bytes) {
+  static uint16_t lfsr = 0xACE1u;
+  unsigned ws_pages = ws_bytes / PAGE_SIZE;
+
+  switch (pattern) {
+  case SEQ: // Consecutive elements
+    return (i * ELEMENT_SIZE) % ws_bytes;
+  case STRIDED: // One element per page, i.e. a column of a page-wide matrix
+    return ((i % ws_pages) * PAGE_SIZE +
+            (i / ws_pages) * ELEMENT_SIZE % PAGE_SIZE) %
+           ws_bytes;
+  case RANDOM: // 16-bit Galois LFSR
+    lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+    return (lfsr * ELEMENT_SIZE) % ws_bytes;
+  case TILED: // 2x4 element tiles over two pages (rows) at a time
+  default: {
+    unsigned tile = i / 8, row = i % 2, col = (i / 2) % 4;
+    unsigned row_pair = (ws_pages >= 2) ? tile % (ws_pages / 2) : 0;
+    return ((2 * row_pair + row) * PAGE_SIZE +
+            (tile * 4 + col) * ELEMENT_SIZE % PAGE_SIZE) %
+           ws_bytes;
+  }
+  }
+}
+
+/**
+ * @brief Access mode of the i-th access, write_pct% of them MM_READWRITE
+ */
+static mm_mode mode(unsigned i, uint8_t write_pct) {
+  return ((i % 4) * 25 < write_pct) ? MM_READWRITE : MM_READONLY;
+}
+
+/**
+ * @brief Start from a cold, clean arena: write back every dirty page, then
+ * drop the pages from SRAM (none are referenced)
+ */
+static void cold(void) {
+  mm_flush();
+  mm_restore(false);
+  mm_reset_stats();
+}
+
+static result_t *record(api_t api, pattern_t pattern, uint8_t pages,
+                        uint8_t write_pct) {
+  if (n_results == N_RESULTS) {
+    while (1)
+      ; // Error: result table full
+  }
+  result_t *r = &results[n_results++];
+  r->api = api;
+  r->pattern = pattern;
+  r->pages = pages;
+  r->write_pct = write_pct;
+  r->calls = 0;
+  r->cycles = 0;
+  r->bytes = 0;
+  r->threshold_updates = 0;
+  return r;
+}
+
+/**
+ * @brief Add one timed call, with the counters since before
+ */
+static void account(result_t *r, uint32_t cycles, mm_stats_t before) {
+  mm_stats_t after = mm_get_stats();
+  r->calls++;
+  r->cycles += (cycles > timer_overhead) ? cycles - timer_overhead : 0;
+  r->bytes += (after.bytes_loaded - before.bytes_loaded) +
+              (after.bytes_written - before.bytes_written);
+  r->threshold_updates += after.threshold_updates - before.threshold_updates;
+}
+
+/**
+ * @brief mm_acquire()/mm_release() of single elements, and
+ * mm_acquire_array()/mm_release_array() of page-sized ranges, which span two
+ * pages unless page aligned
+ */
+static void bench_pattern(pattern_t pattern, uint8_t pages,
+                          uint8_t write_pct) {
+  unsigned ws_bytes = pages * PAGE_SIZE;
+  result_t *acquire = record(API_ACQUIRE, pattern, pages, write_pct);
+  result_t *release = record(API_RELEASE, pattern, pages, write_pct);
+
+  cold();
+  for (unsigned i = 0; i < CALLS; ++i) {
+    uint8_t *ptr = &arena[offset(pattern, i, ws_bytes)];
+    mm_mode m = mode(i, write_pct);
+
+    mm_stats_t before = mm_get_stats();
+    cycle_counter_start();
+    mm_acquire(ptr, m);
+    account(acquire, cycle_counter_read(), before);
+
+    if (m == MM_READWRITE) {
+      *ptr += 1;
+    }
+
+    before = mm_get_stats();
+    cycle_counter_start();
+    mm_release(ptr);
+    account(release, cycle_counter_read(), before);
+  }
+
+  acquire = record(API_ACQUIRE_ARRAY, pattern, pages, write_pct);
+  release = record(API_RELEASE_ARRAY, pattern, pages, write_pct);
+
+  cold();
+  for (unsigned i = 0; i < CALLS; ++i) {
+    // Keep the range within the working set
+    unsigned off = offset(pattern, i, ws_bytes);
+    if (off + PAGE_SIZE > ws_bytes) {
+      off = ws_bytes - PAGE_SIZE;
+    }
+    uint8_t *ptr = &arena[off];
+    mm_mode m = mode(i, write_pct);
+
+    mm_stats_t before = mm_get_stats();
+    cycle_counter_start();
+    mm_acquire_array(ptr, PAGE_SIZE, m);
+    account(acquire, cycle_counter_read(), before);
+
+    if (m == MM_READWRITE) {
+      ptr[PAGE_SIZE - 1] += 1;
+    }
+
+    before = mm_get_stats();
+    cycle_counter_start();
+    mm_release_array(ptr, PAGE_SIZE);
+    account(release, cycle_counter_read(), before);
+  }
+}
+
+/**
+ * @brief mm_acquire_page() walking the working set element by element, as in
+ * a loop over an array
+ */
+static void bench_acquire_page(uint8_t pages, uint8_t write_pct) {
+  const unsigned n_elements = pages * PAGE_SIZE / ELEMENT_SIZE;
+  result_t *r = record(API_ACQUIRE_PAGE, SEQ, pages, write_pct);
+
+  cold();
+  for (unsigned i = 0; i < n_elements;) {
+    uint8_t *ptr = &arena[i * ELEMENT_SIZE];
+    mm_mode m = mode(i, write_pct);
+
+    mm_stats_t before = mm_get_stats();
+    cycle_counter_start();
+    int n = mm_acquire_page(ptr, n_elements - i, ELEMENT_SIZE, m);
+    account(r, cycle_counter_read(), before);
+
+    mm_release(ptr);
+    i += n;
+  }
+}
+
+/**
+ * @brief mm_flush() of a working set of which write_pct% is dirty
+ */
+static void bench_flush(uint8_t pages, uint8_t write_pct) {
+  result_t *r = record(API_FLUSH, SEQ, pages, write_pct);
+
+  cold();
+  for (unsigned i = 0; i < pages; ++i) {
+    uint8_t *ptr = &arena[i * PAGE_SIZE];
+    mm_mode m = mode(i, write_pct);
+    mm_acquire(ptr, m);
+    if (m == MM_READWRITE) {
+      *ptr += 1;
+    }
+    mm_release(ptr);
+  }
+
+  mm_stats_t before = mm_get_stats();
+  cycle_counter_start();
+  mm_flush();
+  account(r, cycle_counter_read(), before);
+}
+
+/**
+ * @brief mm_restore() of a working set held active, as after a power failure
+ */
+static void bench_restore(uint8_t pages) {
+  result_t *r = record(API_RESTORE, SEQ, pages, 0);
+
+  cold();
+  mm_acquire_array(arena, pages * PAGE_SIZE, MM_READONLY);
+
+  mm_stats_t before = mm_get_stats();
+  cycle_counter_start();
+  mm_restore(false);
+  account(r, cycle_counter_read(), before);
+
+  mm_release_array(arena, pages * PAGE_SIZE);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2019-2020, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Managed heap under power failures. Allocates blocks of every size class and
+ * multi-page runs, fills them, and checks and frees them in a pseudo-random
+ * order, so that mm_alloc(), mm_free() and the discard of emptied pages run
+ * across suspends and restores. Built against an iclib with MM_HEAP_SIZE set.
+ */
+
+#include "lib/iclib/ic.h"
+#include "lib/iclib/memory-management.h"
+#include "lib/support/support.h"
+
+#if MM_HEAP_SIZE == 0
+#error "mm-heap needs an iclib built with MM_HEAP_SIZE"
+#endif
+
+/* ------ Parameters ------ */
+#define N_SLOTS 12 // Blocks live at the same time, at most
+#define ROUNDS 400 // Allocations and frees per pass
+
+static const uint16_t block_sizes[] = {PAGE_SIZE / 8, PAGE_SIZE / 4,
+                                       PAGE_SIZE / 2, PAGE_SIZE,
+                                       3 * PAGE_SIZE};
+#define N_SIZES (sizeof(block_sizes) / sizeof(block_sizes[0]))
+
+/* ------ Globals ------ */
+static uint8_t *slots[N_SLOTS]; // Live blocks, NULL if free
+static uint16_t sizes[N_SLOTS];
+static uint8_t tags[N_SLOTS]; // Fill pattern of each block
+static uint16_t lfsr;
+static unsigned errors;
+
+/* ------ Function definitions ------ */
+
+/**
+ * @brief 16-bit Galois LFSR
+ */
+static uint16_t next(void) {
+  lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+  return lfsr;
+}
+
+static void fill(unsigned s) {
+  mm_acquire_array(slots[s], sizes[s], MM_READWRITE);
+  for (uint16_t i = 0; i < sizes[s]; ++i) {
+    slots[s][i] = (uint8_t)(tags[s] + i);
+  }
+  mm_release_array(slots[s], sizes[s]);
+}
+
+static void check(unsigned s) {
+  mm_acquire_array(slots[s], sizes[s], MM_READONLY);
+  for (uint16_t i = 0; i < sizes[s]; ++i) {
+    if (slots[s][i] != (uint8_t)(tags[s] + i)) {
+      errors++;
+      break;
+    }
+  }
+  mm_release_array(slots[s], sizes[s]);
+}
+
+static void release(unsigned s) {
+  check(s);
+  mm_free(slots[s]);
+  slots[s] = NULL;
+}
+
+int verify_benchmark(int result) {
+  (void)result;
+  if (errors) {
+    return 1;
+  }
+  // Everything was freed, so all pages but the metadata form one run
+  void *all = mm_alloc(MM_HEAP_SIZE - PAGE_SIZE);
+  if (all == NULL) {
+    return 1;
+  }
+  mm_free(all);
+  return 0;
+}
+
+void main(void) {
+  for (volatile unsigned pass = 0; pass < 3; ++pass) {
+    indicate_workload_begin();
+    lfsr = 0xACE1u;
+    errors = 0;
+    for (unsigned r = 0; r < ROUNDS; ++r) {
+      const unsigned s = next() % N_SLOTS;
+      if (slots[s] != NULL) {
+        release(s);
+        continue;
+      }
+      sizes[s] = block_sizes[next() % N_SIZES];
+      slots[s] = mm_alloc(sizes[s]);
+      if (slots[s] != NULL) { // NULL when the heap is full
+        tags[s] = (uint8_t)r;
+        fill(s);
+      }
+    }
+    for (unsigned s = 0; s < N_SLOTS; ++s) {
+      if (slots[s] != NULL) {
+        release(s);
+      }
+    }
+    indicate_workload_end();
+    if (verify_benchmark(0) != 0) {
+      indicate_test_fail();
+    }
+    mm_flush();
+    wait();
+  }
+  end_experiment();
+}
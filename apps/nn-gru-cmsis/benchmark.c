@@ -53,13 +53,16 @@
 #define DIM_INPUT 32
 #define DIM_VEC 64
 
-static q7_t update_gate_weights[DIM_VEC * DIM_HISTORY] = UPDATE_GATE_WEIGHT_X4;
-static q7_t reset_gate_weights[DIM_VEC * DIM_HISTORY] = RESET_GATE_WEIGHT_X4;
-static q7_t hidden_state_weights[DIM_VEC * DIM_HISTORY] =
+// Weights and biases are only read, and stay in NVM with hybrid placement
+static q7_t update_gate_weights[DIM_VEC * DIM_HISTORY] FRAM_DIRECT =
+    UPDATE_GATE_WEIGHT_X4;
+static q7_t reset_gate_weights[DIM_VEC * DIM_HISTORY] FRAM_DIRECT =
+    RESET_GATE_WEIGHT_X4;
+static q7_t hidden_state_weights[DIM_VEC * DIM_HISTORY] FRAM_DIRECT =
     HIDDEN_STATE_WEIGHT_X4;
-static q7_t update_gate_bias[DIM_HISTORY] = UPDATE_GATE_BIAS;
-static q7_t reset_gate_bias[DIM_HISTORY] = RESET_GATE_BIAS;
-static q7_t hidden_state_bias[DIM_HISTORY] = HIDDEN_STATE_BIAS;
+static q7_t update_gate_bias[DIM_HISTORY] FRAM_DIRECT = UPDATE_GATE_BIAS;
+static q7_t reset_gate_bias[DIM_HISTORY] FRAM_DIRECT = RESET_GATE_BIAS;
+static q7_t hidden_state_bias[DIM_HISTORY] FRAM_DIRECT = HIDDEN_STATE_BIAS;
 
 static q15_t test_input1[DIM_INPUT] = INPUT_DATA1;
 static q15_t test_history[DIM_HISTORY] = HISTORY_DATA;
@@ -20,6 +20,7 @@ find_program(TC-GXX ${BIN_PREFIX}-g++ PATHS ${BINPATHS})
 find_program(TC-OBJCOPY ${BIN_PREFIX}-objcopy PATHS ${BINPATHS})
 find_program(TC-SIZE ${BIN_PREFIX}-size PATHS ${BINPATHS})
 find_program(TC-OBJDUMP ${BIN_PREFIX}-objdump PATHS ${BINPATHS})
+find_program(TC-NM ${BIN_PREFIX}-nm PATHS ${BINPATHS})
 
 # Define toolchain
 set(CMAKE_SYSTEM_NAME Generic)
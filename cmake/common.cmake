@@ -101,6 +101,23 @@ ELSEIF(${TARGET_ARCH} STREQUAL "cm0")
 
 set(SUPPORT_LIBS nosys m gcc c)
 
+ELSEIF(${TARGET_ARCH} STREQUAL "host")
+
+  add_compile_options(
+      -DHOST_ARCH
+      -std=gnu99
+      -Wall
+      -Wno-main
+      -fno-common
+      -fno-zero-initialized-in-bss
+      -fno-pie
+    )
+
+  # Fixed addresses, so that traces and maps can be compared between runs
+  link_libraries(-no-pie)
+
+  set(SUPPORT_LIBS support-${TARGET_ARCH} m)
+
 ELSE()
   message(ERROR "Invalid TARGET_ARCH: ${TARGET_ARCH}")
 ENDIF()
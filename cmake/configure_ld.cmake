@@ -21,6 +21,7 @@ set(LD_BOOT_STACK_ALLOC         "dnvm")
 set(LD_STACK_ALLOC              "dnvm")
 set(LD_HEAP_ALLOC               "dnvm")
 set(LD_MMDATA_ALLOC             "dnvm")
+set(LD_SRAM_HOT_ALLOC           "sram AT> dnvm")
 
 configure_file(${CM0_LD_SRC} ${CMAKE_BINARY_DIR}/cm0-QR.ld)
 configure_file(${CM0_LD_SRC} ${CMAKE_BINARY_DIR}/cm0-CS.ld)
@@ -31,6 +32,7 @@ set(LD_BOOT_STACK_ALLOC         "sram")
 set(LD_STACK_ALLOC              "sram")
 set(LD_HEAP_ALLOC               "sram AT> dnvm")
 set(LD_MMDATA_ALLOC             "sram AT> dnvm")
+set(LD_SRAM_HOT_ALLOC           "sram AT> dnvm")
 
 configure_file(${CM0_LD_SRC} ${CMAKE_BINARY_DIR}/cm0-AS.ld)
 configure_file(${CM0_LD_SRC} ${CMAKE_BINARY_DIR}/cm0-MS.ld)
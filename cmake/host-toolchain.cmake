@@ -0,0 +1,32 @@
+#
+# Copyright (c) 2019-2020, University of Southampton and Contributors.
+# All rights reserved.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+
+# Native build: iclib and apps run as Linux processes, with power failures
+# simulated by lib/iclib/host-ic.c
+
+# Find toolchain programs
+find_program(TC-GCC gcc)
+find_program(TC-OBJCOPY objcopy)
+find_program(TC-SIZE size)
+find_program(TC-OBJDUMP objdump)
+find_program(TC-NM nm)
+
+# Define toolchain
+set(CMAKE_ASM_COMPILER ${TC-GCC} CACHE INTERNAL "")
+set(CMAKE_C_COMPILER ${TC-GCC} CACHE INTERNAL "")
+
+#Debug by default
+if(NOT CMAKE_BUILD_TYPE)
+  set(CMAKE_BUILD_TYPE Debug CACHE STRING "Choose the type of build." FORCE)
+endif(NOT CMAKE_BUILD_TYPE)
+
+# Nothing to upload, run the executable instead
+function(add_upload EXECUTABLE)
+  add_custom_target(run_${EXECUTABLE}
+    COMMAND $<TARGET_FILE:${EXECUTABLE}>
+    DEPENDS ${EXECUTABLE})
+endfunction(add_upload)
@@ -13,6 +13,7 @@ find_program(TC-GXX msp430-elf-g++ $ENV{MSP430_GCC_ROOT}/bin)
 find_program(TC-OBJCOPY msp430-elf-objcopy $ENV{MSP430_GCC_ROOT}/bin)
 find_program(TC-SIZE msp430-elf-size $ENV{MSP430_GCC_ROOT}/bin)
 find_program(TC-OBJDUMP msp430-elf-objdump $ENV{MSP430_GCC_ROOT}/bin)
+find_program(TC-NM msp430-elf-nm $ENV{MSP430_GCC_ROOT}/bin)
 find_program(MSPDEBUG mspdebug)
 
 # Define toolchain
@@ -9,9 +9,45 @@ cmake_minimum_required(VERSION 3.13)
 
 # Commmon function to add linker script and definitions for each target
 
+# IC_LIBRARY selects a variant of iclib, e.g. for mm-bench, and IC_MM_CONFIG
+# its <PAGE_SIZE>x<MAX_DIRTY_PAGES>, if not those of config.h. With MS, such a
+# line in ${ICLIB_PROFILE_DIR}/${TESTNAME}.mmconfig (see
+# lib/iclib/simulate-page-policy.py) selects the variant built with these
+# settings.
+set(MM_CONFIG_FILE ${ICLIB_PROFILE_DIR}/${TESTNAME}.mmconfig)
+IF(NOT IC_LIBRARY AND ICLIB_PROFILE_DIR AND ${METHOD} STREQUAL "MS"
+    AND EXISTS ${MM_CONFIG_FILE})
+  file(STRINGS ${MM_CONFIG_FILE} MM_CONFIG REGEX "^[0-9]+x[0-9]+$")
+  IF(MM_CONFIG)
+    list(GET MM_CONFIG 0 IC_MM_CONFIG)
+    set_property(GLOBAL APPEND PROPERTY ICLIB_MM_CONFIGS ${IC_MM_CONFIG})
+    set(IC_LIBRARY ic-MS-${TARGET_ARCH}-tuned-${IC_MM_CONFIG})
+  ENDIF()
+ENDIF()
+IF(NOT IC_LIBRARY)
+  set(IC_LIBRARY ic-${METHOD}-${TARGET_ARCH})
+ENDIF()
+
+# Memory manager settings of the variant, for the budget check below
+set(MM_CONFIG_ARGS "")
+IF(IC_MM_CONFIG)
+  string(REPLACE "x" ";" MM_CONFIG_VALUES ${IC_MM_CONFIG})
+  list(GET MM_CONFIG_VALUES 0 MM_PAGE_SIZE)
+  list(GET MM_CONFIG_VALUES 1 MM_MAX_DIRTY)
+  set(MM_CONFIG_ARGS --page-size ${MM_PAGE_SIZE}
+    --max-dirty-pages ${MM_MAX_DIRTY})
+ENDIF()
+
+# Threshold formula of the supply monitor, for the budget checks below
+IF(${ICLIB_COMP_MONITOR})
+  set(MONITOR_ARGS --comp-monitor)
+ELSE()
+  set(MONITOR_ARGS "")
+ENDIF()
+
 target_link_libraries( ${TESTNAME}
   LINK_PUBLIC support-${TARGET_ARCH}
-  LINK_PUBLIC ic-${METHOD}-${TARGET_ARCH}
+  LINK_PUBLIC ${IC_LIBRARY}
   ${SUPPORT_LIBS}
   )
 
@@ -24,6 +60,9 @@ ELSEIF(${METHOD} STREQUAL "MS")
 ENDIF()
 
 
+# Linker script fragments generated for this target
+set(LD_FRAG_DIR ${CMAKE_CURRENT_BINARY_DIR}/${TESTNAME}-ld)
+
 IF(${TARGET_ARCH} STREQUAL "msp430")
   IF (${METHOD} STREQUAL "QR")
       target_link_options( ${TESTNAME}
@@ -32,9 +71,105 @@ IF(${TARGET_ARCH} STREQUAL "msp430")
       target_link_options( ${TESTNAME}
           PRIVATE -T${PROJECT_SOURCE_DIR}/lib/support/msp430fr5994.ld)
   ENDIF()
+
+  # Hot code/table placement fragments included by the linker script, empty
+  # unless ${ICLIB_PROFILE_DIR}/${TESTNAME}.profile exists
+  set(HOT_PROFILE ${ICLIB_PROFILE_DIR}/${TESTNAME}.profile)
+  IF(ICLIB_PROFILE_DIR AND EXISTS ${HOT_PROFILE}
+      AND NOT ${METHOD} STREQUAL "QR")
+    add_custom_command(
+      OUTPUT ${LD_FRAG_DIR}/hot-text.ld ${LD_FRAG_DIR}/hot-rodata.ld
+      COMMAND ${PYTHON_EXECUTABLE}
+        ${PROJECT_SOURCE_DIR}/lib/support/generate-hot-placement.py place
+        --profile ${HOT_PROFILE}
+        --budget ${ICLIB_HOT_BUDGET}
+        -o ${LD_FRAG_DIR}
+      DEPENDS ${HOT_PROFILE}
+        ${PROJECT_SOURCE_DIR}/lib/support/generate-hot-placement.py
+      )
+    add_custom_target(${TESTNAME}-hot
+      DEPENDS ${LD_FRAG_DIR}/hot-text.ld ${LD_FRAG_DIR}/hot-rodata.ld)
+    add_dependencies(${TESTNAME} ${TESTNAME}-hot)
+  ELSE()
+    file(WRITE ${LD_FRAG_DIR}/hot-text.ld "/* No profile */\n")
+    file(WRITE ${LD_FRAG_DIR}/hot-rodata.ld "/* No profile */\n")
+  ENDIF()
+
+  # Map samples of a profiling run to ${ICLIB_PROFILE_DIR}/${TESTNAME}.profile
+  IF(ICLIB_PROFILE_DIR)
+    add_custom_target(profile_${TESTNAME}
+      COMMAND ${PYTHON_EXECUTABLE}
+        ${PROJECT_SOURCE_DIR}/lib/support/generate-hot-placement.py profile
+        --nm ${TC-NM}
+        --elf "$<TARGET_FILE:${TESTNAME}>"
+        --samples ${ICLIB_PROFILE_DIR}/${TESTNAME}.samples
+        -o ${HOT_PROFILE}
+      DEPENDS ${TESTNAME})
+  ENDIF()
 ELSEIF(${TARGET_ARCH} STREQUAL "cm0")
     target_link_options( ${TESTNAME}
       PRIVATE -T${PROJECT_BINARY_DIR}/cm0-${METHOD}.ld)
+ELSEIF(${TARGET_ARCH} STREQUAL "host")
+    # Added to the default linker script; iclib_boot() is only referenced as
+    # a constructor
+    target_link_options( ${TESTNAME}
+      PRIVATE -Wl,-T,${PROJECT_SOURCE_DIR}/lib/support/host.ld
+      PRIVATE -Wl,-u,iclib_boot)
+ENDIF()
+
+# Order of .mmdata objects, empty unless
+# ${ICLIB_PROFILE_DIR}/${TESTNAME}-mmdata.ld exists
+set(MMDATA_LAYOUT ${ICLIB_PROFILE_DIR}/${TESTNAME}-mmdata.ld)
+IF(ICLIB_PROFILE_DIR AND EXISTS ${MMDATA_LAYOUT})
+  configure_file(${MMDATA_LAYOUT} ${LD_FRAG_DIR}/mmdata-order.ld COPYONLY)
+ELSE()
+  file(WRITE ${LD_FRAG_DIR}/mmdata-order.ld "/* Link order */\n")
+ENDIF()
+target_link_options( ${TESTNAME} PRIVATE -L${LD_FRAG_DIR})
+
+# Lay out .mmdata from an acquire trace (or hints) of this build, see
+# lib/iclib/generate-mmdata-layout.py
+IF(ICLIB_PROFILE_DIR)
+  target_link_options( ${TESTNAME}
+    PRIVATE -Wl,-Map=$<TARGET_FILE:${TESTNAME}>.map)
+  IF(EXISTS ${ICLIB_PROFILE_DIR}/${TESTNAME}.mmhints)
+    set(MMDATA_AFFINITY --hints ${ICLIB_PROFILE_DIR}/${TESTNAME}.mmhints)
+  ELSE()
+    set(MMDATA_AFFINITY --trace ${ICLIB_PROFILE_DIR}/${TESTNAME}.mmtrace)
+  ENDIF()
+  add_custom_target(mmdata_layout_${TESTNAME}
+    COMMAND ${PYTHON_EXECUTABLE}
+      ${PROJECT_SOURCE_DIR}/lib/iclib/generate-mmdata-layout.py
+      --config ${PROJECT_SOURCE_DIR}/lib/iclib/config.h
+      --nm ${TC-NM}
+      --elf "$<TARGET_FILE:${TESTNAME}>"
+      --map "$<TARGET_FILE:${TESTNAME}>.map"
+      ${MMDATA_AFFINITY}
+      -o ${MMDATA_LAYOUT}
+    DEPENDS ${TESTNAME})
+
+  # Pick PAGE_SIZE and MAX_DIRTY_PAGES from the same trace
+  IF(${METHOD} STREQUAL "MS")
+    add_custom_target(mm_tune_${TESTNAME}
+      COMMAND ${PYTHON_EXECUTABLE}
+        ${PROJECT_SOURCE_DIR}/lib/iclib/simulate-page-policy.py
+        --config ${PROJECT_SOURCE_DIR}/lib/iclib/config.h
+        --nm ${TC-NM}
+        --elf "$<TARGET_FILE:${TESTNAME}>"
+        --trace ${ICLIB_PROFILE_DIR}/${TESTNAME}.mmtrace
+        ${MONITOR_ARGS}
+        -o ${MM_CONFIG_FILE}
+      DEPENDS ${TESTNAME})
+  ENDIF()
+
+  # Record the trace on the host
+  IF(${TARGET_ARCH} STREQUAL "host")
+    add_custom_target(mmtrace_${TESTNAME}
+      COMMAND ${CMAKE_COMMAND} -E env
+        ICLIB_MM_TRACE=${ICLIB_PROFILE_DIR}/${TESTNAME}.mmtrace
+        "$<TARGET_FILE:${TESTNAME}>"
+      DEPENDS ${TESTNAME})
+  ENDIF()
 ENDIF()
 
 set_target_properties(${TESTNAME} PROPERTIES SUFFIX ".elf")
@@ -43,8 +178,39 @@ set_target_properties(${TESTNAME} PROPERTIES SUFFIX ".elf")
 add_custom_command(TARGET ${TESTNAME} POST_BUILD
   COMMAND ${TC-SIZE} -A -x "$<TARGET_FILE:${TESTNAME}>" > ${TESTNAME}.map
   COMMAND ${TC-OBJDUMP} -d "$<TARGET_FILE:${TESTNAME}>" > ${TESTNAME}.lst
-  COMMAND ${TC-OBJCOPY} -O ihex "$<TARGET_FILE:${TESTNAME}>" ${TESTNAME}.hex
   )
+IF(NOT ${TARGET_ARCH} STREQUAL "host")
+  add_custom_command(TARGET ${TESTNAME} POST_BUILD
+    COMMAND ${TC-OBJCOPY} -O ihex "$<TARGET_FILE:${TESTNAME}>" ${TESTNAME}.hex
+    )
+ENDIF()
+
+# Check worst-case checkpoint fits between VON and VMAX
+IF(${TARGET_ARCH} STREQUAL "msp430" AND NOT ${METHOD} STREQUAL "QR"
+    AND ICLIB_CHECK_BUDGET)
+  IF(ICLIB_ALLOW_DIRTY_LIMIT)
+    set(BUDGET_ARGS --allow-dirty-limit)
+  ELSE()
+    set(BUDGET_ARGS "")
+  ENDIF()
+  add_custom_command(TARGET ${TESTNAME} POST_BUILD
+    COMMAND ${PYTHON_EXECUTABLE}
+      ${PROJECT_SOURCE_DIR}/lib/iclib/generate-dvdb-table.py check
+      --config ${PROJECT_SOURCE_DIR}/lib/iclib/config.h
+      --method ${METHOD}
+      --max-bytes ${ICLIB_MAX_STATE_BYTES}
+      --size-tool ${TC-SIZE}
+      --elf "$<TARGET_FILE:${TESTNAME}>"
+      ${MONITOR_ARGS}
+      ${MM_CONFIG_ARGS}
+      ${BUDGET_ARGS}
+    )
+ENDIF()
 
 # add upload target
 add_upload(${TESTNAME})
+
+# All app executables, for targets that run them (e.g. supply_replay)
+set_property(GLOBAL APPEND PROPERTY ICLIB_APP_TARGETS ${TESTNAME})
+unset(IC_LIBRARY)
+unset(IC_MM_CONFIG)
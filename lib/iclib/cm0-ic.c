@@ -21,9 +21,12 @@ extern uint8_t __stack_low, __stack_high, __stack_size;
 extern uint8_t __data_low, __data_high, __data_loadLow;
 extern uint8_t __bss_low, __bss_high, __bss_loadLow;
 extern uint8_t __mmdata_low, __mmdata_high, __mmdata_loadLow;
+extern uint8_t __sram_hot_low, __sram_hot_high, __sram_hot_loadLow;
 extern uint8_t __boot_stack_high;
 
 // ------------- Globals -------------------------------------------------------
+// The external power supervisor only provides a single (suspend) warning
+volatile bool ic_presuspend = false;
 
 // ------------- PERSISTENT VARIABLES ------------------------------------------
 
@@ -34,8 +37,15 @@ int suspending PERSISTENT;        /*! Flag to determine whether returning from
                                  suspend() or restore() */
 int snapshotValid PERSISTENT = 0; //! Flag: whether snapshot is valid
 
+// Restore progress
+restore_stage_t restore_stage PERSISTENT = RESTORE_IDLE;
+
+// Checkpoint outcomes
+ic_outcomes_t outcomes PERSISTENT = {0, 0, 0, 0};
+int suspend_in_progress PERSISTENT = 0; //! Flag: suspend started, not done
+
 /* ------ Function Prototypes -----------------------------------------------*/
-static void checkpoint(bool suspend);
+static unsigned checkpoint(bool suspend);
 
 /* ------ ASM functions ---------------------------------------------------- */
 extern void suspend_stack_and_regs(uint32_t *saved_sp, int *snapshotValid,
@@ -48,14 +58,46 @@ extern void restore_registers(uint32_t *saved_sp);
 void __attribute__((optimize(1))) _start() {
   target_init();
   assert_keep_alive();
+#ifdef IC_TIMER
+  cycle_counter_start(); // Starts SysTick for ic_timer_read()
+#endif
+  ic_phase_begin(IC_PHASE_BOOT);
+  ic_trace_event(IC_EVENT_BOOT, 0, 0);
+
+  if (suspend_in_progress) { // Power failed before/after suspend completed?
+    suspend_in_progress = 0;
+    if (snapshotValid) {
+      outcomes.suspend_ok++;
+    } else {
+      outcomes.suspend_fail++;
+    }
+  }
+
+  if (restore_stage != RESTORE_IDLE) {
+    // Power failed during the previous restore, SRAM contents are lost and
+    // restore must start over.
+    outcomes.restore_fail++;
+  }
+
+  ic_phase_end(IC_PHASE_BOOT, 0);
+  ic_phase_begin(IC_PHASE_RESTORE);
+  ic_trace_event(IC_EVENT_RESTORE, 0, 0);
+
+  // SRAM_HOT objects, from their initial values or the last checkpoint
+  memcpy(&__sram_hot_low, &__sram_hot_loadLow,
+         &__sram_hot_high - &__sram_hot_low);
 
 #if defined(ALLOCATEDSTATE) || defined(MANAGEDSTATE)
+  restore_stage = RESTORE_DATA;
   memcpy(&__data_low, &__data_loadLow, &__data_high - &__data_low);
+  restore_stage = RESTORE_BSS;
   memcpy(&__bss_low, &__bss_loadLow, &__bss_high - &__bss_low);
   const uint32_t mmdata_size = &__mmdata_high - &__mmdata_low;
   ic_update_thresholds(mmdata_size, mmdata_size);
   mm_init_lru();
-  mm_restore();
+  restore_stage = RESTORE_MMDATA;
+  mm_restore(false);
+  restore_stage = RESTORE_STACK;
 #endif
 
   // Enable suspend interrupt on posedge of v_warn
@@ -73,8 +115,16 @@ void __attribute__((optimize(1))) _start() {
     uint8_t *src = (uint8_t *)&stack_snapshot + ((uint32_t)&__stack_size - len);
     memcpy(sp, src, len);
 #endif
+    restore_stage = RESTORE_IDLE;
+    outcomes.restore_ok++;
+    ic_phase_end(IC_PHASE_RESTORE, 0);
+    ic_trace_event(IC_EVENT_RESTORED, 0, 0);
+    suspending = 0;
     restore_registers(&saved_stack_pointer); // Returns to suspend()
   }
+  restore_stage = RESTORE_IDLE;
+  ic_phase_end(IC_PHASE_RESTORE, 0); // No snapshot, initial state loaded
+  ic_trace_event(IC_EVENT_RESTORED, 0, 0);
 
   // First power-up: set SP and start execution
   __set_MSP((uint32_t)&__stack_high);
@@ -89,25 +139,104 @@ __attribute__((optimize(1))) void Interrupt0_Handler() {
   volatile unsigned iostate = Gpio->DATA.WORD;
   snapshotValid = 0;
   suspending = 1;
+  suspend_in_progress = 1;
+#ifdef DEEP_SLEEP
+  SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk; // Deep sleep in wfe until power is cut
+#endif
+  ic_phase_begin(IC_PHASE_SUSPEND);
+  ic_trace_event(IC_EVENT_SUSPEND, 0, 0);
   checkpoint(/*suspend=*/true);
   Gpio->DATA.WORD = iostate;
 }
 
-__attribute__((optimize(1))) static void checkpoint(bool suspend) {
+/**
+ * @brief Save registers and volatile state.
+ * @param suspend sleep after saving if true, otherwise return
+ * @return number of bytes saved, excluding the stack
+ */
+__attribute__((optimize(1))) static unsigned checkpoint(bool suspend) {
+  unsigned bytes = 0;
+  memcpy(&__sram_hot_loadLow, &__sram_hot_low,
+         &__sram_hot_high - &__sram_hot_low);
+  bytes += &__sram_hot_high - &__sram_hot_low;
 #if defined(ALLOCATEDSTATE) || defined(MANAGEDSTATE)
   // Save data, mmdata & stack
-  mm_flush();
+  bytes += mm_flush();
   memcpy(&__data_loadLow, &__data_low, &__data_high - &__data_low);
+  bytes += &__data_high - &__data_low;
   memcpy(&__bss_loadLow, &__bss_low, &__bss_high - &__bss_low);
+  bytes += &__bss_high - &__bss_low;
+#elif !defined(QUICKRECALL)
+#error "ICLIB: IC method not defined or invalid."
+#endif
+  mm_stats_checkpoint(bytes);
+  if (suspend) { // Not including the registers and stack
+    ic_phase_end(IC_PHASE_SUSPEND, bytes);
+    ic_trace_event(IC_EVENT_SUSPENDED, 0, bytes);
+  }
+#if defined(ALLOCATEDSTATE) || defined(MANAGEDSTATE)
   suspend_stack_and_regs(&saved_stack_pointer, &snapshotValid, stack_snapshot,
                          !suspend);
-#elif defined(QUICKRECALL) // Save registers only
+#else // Save registers only
   suspend_regs(&saved_stack_pointer, &snapshotValid, !suspend);
-#else
-#error "ICLIB: IC method not defined or invalid."
 #endif
+  return bytes;
+}
+
+__attribute__((optimize(1))) ic_checkpoint_cost_t ic_checkpoint(void) {
+  ic_checkpoint_cost_t cost = {0, 0};
+  bool primask = get_interrupt_enable(); // PRIMASK set = irqs disabled
+
+  disable_interrupt(); // Don't suspend while checkpointing
+  ic_phase_begin(IC_PHASE_CHECKPOINT);
+  cycle_counter_start();
+  snapshotValid = 0;
+  suspending = 1;          // Cleared by the restore in _start()
+  suspend_in_progress = 1; // Counts as a failed suspend if power fails
+  unsigned bytes = checkpoint(/*suspend=*/false);
+
+  //!! Execution enters this line either:
+  // 1. when returning from checkpoint(), 2. when restored from it
+  if (suspending) { // Checkpoint taken, continue execution
+    suspend_in_progress = 0;
+    cost.cycles = cycle_counter_read();
+    // Registers (pushed by suspend_stack_and_regs) and stack
+    cost.bytes = bytes + (&__stack_high - (uint8_t *)saved_stack_pointer);
+    ic_phase_end(IC_PHASE_CHECKPOINT, cost.bytes);
+    ic_trace_event(IC_EVENT_CHECKPOINT, 0, cost.bytes);
+  } // else restored from this checkpoint, cost is not meaningful
+
+  if (!primask) {
+    enable_interrupt();
+  }
+  return cost;
 }
 
 void ic_update_thresholds(unsigned n_suspend, unsigned n_restore) {
   // Do nothing
 }
+
+unsigned ic_max_dirty_pages(unsigned n_restore) {
+  // Suspend energy is guaranteed by the external power supervisor
+  return MAX_DIRTY_PAGES;
+}
+
+bool ic_calibrate(void) {
+  // Not supported: no supply voltage measurement, thresholds are set by the
+  // external power supervisor
+  return false;
+}
+
+ic_outcomes_t ic_get_outcomes(void) { return outcomes; }
+
+#ifdef IC_TIMER
+uint32_t ic_timer_read(void) {
+  return SysTick_LOAD_RELOAD_Msk - SysTick->VAL;
+}
+#endif
+
+bool ic_restore_should_yield(void) {
+  // Thresholds are handled by the external power supervisor, which removes
+  // power (and SRAM contents) on v_warn, so there is nothing to wait for.
+  return false;
+}
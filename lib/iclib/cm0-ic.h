@@ -8,12 +8,12 @@
 #ifndef CM0_IC_H
 #define CM0_IC_H
 
-#define PERSISTENT __attribute__((section(".persistent")))
-#define MMDATA __attribute__((section(".mmdata")))
-
 #include <stdint.h>
 #include "lib/iclib/config.h"
 
+// ic_timer_read() wraps: SysTick counts the core clock (24 bits)
+#define IC_TIMER_MASK 0xFFFFFFul
+
 // Boot function
 void _start();
 
@@ -15,10 +15,23 @@
 #define BSS_SIZE 0x1000
 #define DATA_SIZE 0x2000
 #define MMDATA_SIZE 0x2000
+#define SRAM_HOT_SIZE 0x100 // SRAM_HOT objects, saved separately by QR
 
 /* ------ Memory manager ----------------------------------------------------*/
+// Both can be set per build, e.g. by the mm-bench configurations
+#ifndef PAGE_SIZE
 #define PAGE_SIZE 128u
+#endif
+// Size of the LRU table, i.e. upper bound on dirty pages. The actual limit is
+// set at run time by ic_max_dirty_pages() from VMAX and the vdrop model.
+#ifndef MAX_DIRTY_PAGES
 #define MAX_DIRTY_PAGES 20
+#endif
+// Managed heap for mm_alloc(), at the start of .mmdata. A multiple of
+// PAGE_SIZE, 0 disables the heap.
+#ifndef MM_HEAP_SIZE
+#define MM_HEAP_SIZE 0
+#endif
 
 /* ------ Threshold Calculation ---------------------------------------------*/
 #define VMAX 3665  // 3.58 V maximum operating voltage
@@ -33,4 +46,49 @@
 
 #define V_C 102  // 205 // ~0.2 V Voltage buffer for useful compute
 
+/* ------ Calibration (ic_calibrate) ----------------------------------------*/
+#define CAL_CHUNK 256  // Bytes per fastmemcpy transfer
+#define CAL_REPEAT 16  // Transfers per sample
+#define CAL_STEPS 8    // Number of samples fitted
+
+/* ------ Adaptive ADC sampling (ADC12 supply monitor) ----------------------*/
+// The ADC samples slowly (~3 ms) while the supply is more than ADC_SLOW_BAND
+// above the suspend threshold, and at full rate (~0.2 ms) within the band.
+// ADC_SLOW_BAND must exceed the worst-case supply drop in one slow period;
+// the suspend threshold is raised by ADC_FAST_LAG, the worst-case drop in one
+// fast period.
+#define ADC_SLOW_BAND 205  // ~0.2 V
+#define ADC_FAST_LAG 10    // ~0.01 V
+
+/* ------ Dynamic frequency scaling (DFS) ----------------------------------*/
+#define DFS_HIGH_WAIT 1  // FRAM wait states at 16 MHz MCLK
+
+/* ------ Deep sleep while charging (DEEP_SLEEP) ---------------------------*/
+// RTC wake-up interval from LPM3.5, as RT1IP_n: 128 Hz / 2^(n+1)
+#define DEEP_SLEEP_INTERVAL RT1IP_2  // 16 Hz, ~62 ms
+#define LFXT_START_TIMEOUT 1000      // ms to wait for the crystal at cold boot
+
+/* ------ COMP_E supply monitor (COMP_MONITOR) -----------------------------*/
+#define COMP_VCC_DIV 2  // External Vcc divider onto C12, e.g. two equal resistors
+
+// Early-warning band above the suspend threshold, where dirty pages are
+// trickled back to FRAM ahead of suspend (ManagedState only)
+#define V_PRESUSPEND 102  // ~0.1 V
+
+// Adaptive guard bands on the suspend and restore thresholds. A failed
+// suspend/restore widens the band by GUARD_STEP_UP; GUARD_STREAK successes in
+// a row, all with more than GUARD_STEP_DOWN headroom, shrink it by
+// GUARD_STEP_DOWN.
+#define GUARD_STEP_UP 41    // ~0.04 V
+#define GUARD_STEP_DOWN 10  // ~0.01 V
+#define GUARD_STREAK 8
+#define GUARD_MIN (-51)     // ~-0.05 V
+#define GUARD_MAX 205       // ~0.2 V
+
+/* ------ Event trace (IC_TRACE) --------------------------------------------*/
+// Records in the ring buffer, a power of two. Each takes 6 bytes of NVM.
+#ifndef IC_TRACE_SIZE
+#define IC_TRACE_SIZE 256
+#endif
+
 #endif /* SRC_CONFIG_H_ */
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019-2020, University of Southampton and Contributors.
+# All rights reserved.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+
+"""
+Decode the binary event trace of iclib (IC_TRACE, see lib/iclib/ic-trace.c)
+into a timeline, and summarise it: how often the application suspends and
+checkpoints, and which pages are loaded, written back and evicted the most.
+
+The input is the `ic_trace` ring buffer, little endian, as written by the host
+target with ICLIB_EVENT_TRACE=<file>, or dumped from a device, e.g. in gdb:
+  dump binary memory trace.bin &ic_trace (char *)&ic_trace + sizeof(ic_trace)
+
+Times are in cycles of the target's timer (ns on the host), or in ms with
+--hz. Each BOOT restarts the timer, the time without power is not known and
+not counted.
+
+Usage:
+  decode-event-trace.py trace.bin
+  decode-event-trace.py trace.bin --hz 8e6 --csv timeline.csv --summary-only
+"""
+
+import argparse
+import collections
+import csv
+import struct
+import sys
+
+MAGIC = 0x1CE7
+HEADER = struct.Struct('<HHII')  # magic, size, n, last
+RECORD = struct.Struct('<BBHH')  # event, arg, dt, value
+
+# ic_event_t, in order
+EVENTS = ['TIME', 'BOOT', 'SUSPEND', 'SUSPENDED', 'RESTORE', 'RESTORED',
+          'CHECKPOINT', 'ACQUIRE', 'RELEASE', 'LOAD', 'WRITEBACK', 'EVICT',
+          'FLUSH', 'SUSPEND_THR', 'RESTORE_THR', 'MARK', 'THR_CLIPPED']
+PAGE_EVENTS = {'ACQUIRE', 'RELEASE', 'LOAD', 'WRITEBACK', 'EVICT'}
+
+
+def read_trace(path):
+    """Return the records in the buffer, oldest first, and how many the ring
+    buffer dropped"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if len(data) < HEADER.size:
+        sys.exit('error: {} is too short for a trace'.format(path))
+    magic, size, n, _ = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        sys.exit('error: {} is not an event trace (magic {:#x})'.format(
+            path, magic))
+    if len(data) < HEADER.size + size * RECORD.size:
+        sys.exit('error: {} is truncated'.format(path))
+
+    records = [RECORD.unpack_from(data, HEADER.size + i * RECORD.size)
+               for i in range(size)]
+    if n <= size:
+        return records[:n], 0
+    first = n % size
+    return records[first:] + records[:first], n - size
+
+
+def timeline(records):
+    """Yield (time, dt, event, arg, value), folding TIME records into the
+    interval of the next event"""
+    time = 0
+    carry = 0
+    for event, arg, dt, value in records:
+        name = EVENTS[event] if event < len(EVENTS) else str(event)
+        if name == 'TIME':
+            carry += dt + (value << 16)
+            continue
+        dt += carry
+        carry = 0
+        time += dt
+        yield time, dt, name, arg, value
+
+
+def describe(name, arg, value):
+    if name in PAGE_EVENTS:
+        extra = ''
+        if name == 'ACQUIRE':
+            extra = ' rw' if value else ' ro'
+        elif name == 'EVICT' and value:
+            extra = ' pre-suspend'
+        return 'page {}{}'.format(arg, extra)
+    if name in ('SUSPENDED', 'RESTORED', 'CHECKPOINT', 'FLUSH'):
+        return '{} bytes'.format(value) if value else ''
+    if name == 'THR_CLIPPED':
+        return 'restore needs {:.3f} V'.format(value / 1024)
+    if name in ('SUSPEND_THR', 'RESTORE_THR'):
+        return '{:.3f} V'.format(value / 1024)
+    if name == 'MARK':
+        return '{} {}'.format(arg, value)
+    return ''
+
+
+def summary(events, dropped, fmt):
+    counts = collections.Counter(e[2] for e in events)
+    print('{} events{}'.format(
+        len(events), ', {} older ones dropped by the ring buffer'.format(
+            dropped) if dropped else ''))
+    for name in EVENTS[1:]:
+        if counts[name]:
+            print('  {:12} {:8}'.format(name, counts[name]))
+
+    # Compute time between consecutive suspends/checkpoints, within a boot
+    for kind in ('SUSPEND', 'CHECKPOINT'):
+        gaps = []
+        previous = None
+        for time, _, name, _, _ in events:
+            if name == 'BOOT':
+                previous = None
+            elif name == kind:
+                if previous is not None:
+                    gaps.append(time - previous)
+                previous = time
+        if gaps:
+            print('{} every {} on average'.format(
+                kind.lower(), fmt(sum(gaps) / len(gaps))))
+
+    pages = collections.defaultdict(collections.Counter)
+    for _, _, name, arg, _ in events:
+        if name in ('LOAD', 'WRITEBACK', 'EVICT'):
+            pages[arg][name] += 1
+    if pages:
+        print('{:>6} {:>8} {:>10} {:>8}'.format('page', 'loads',
+                                                'writebacks', 'evictions'))
+        busiest = sorted(pages, key=lambda p: -sum(pages[p].values()))
+        for page in busiest[:10]:
+            print('{:6} {:8} {:10} {:8}'.format(page, pages[page]['LOAD'],
+                                                pages[page]['WRITEBACK'],
+                                                pages[page]['EVICT']))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+            formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('trace', help='binary trace')
+    parser.add_argument('--hz', type=float,
+                        help='timer frequency, to print times in ms')
+    parser.add_argument('--csv', help='write the timeline to a CSV')
+    parser.add_argument('--summary-only', action='store_true',
+                        help="don't print the timeline")
+    args = parser.parse_args()
+
+    if args.hz:
+        fmt = lambda t: '{:.3f} ms'.format(t * 1e3 / args.hz)
+    else:
+        fmt = lambda t: '{:.0f}'.format(t)
+
+    records, dropped = read_trace(args.trace)
+    events = list(timeline(records))
+
+    if not args.summary_only:
+        depth = 0
+        for time, dt, name, arg, value in events:
+            if name in ('SUSPENDED', 'RESTORED', 'BOOT'):
+                depth = 0
+            print('{:>16} {:>12}  {}{:12} {}'.format(
+                fmt(time), '+' + fmt(dt), '  ' * depth, name,
+                describe(name, arg, value)))
+            if name in ('SUSPEND', 'RESTORE'):
+                depth = 1
+
+    if args.csv:
+        with open(args.csv, 'w', newline='') as out:
+            writer = csv.writer(out)
+            writer.writerow(['time', 'dt', 'event', 'arg', 'value'])
+            writer.writerows(events)
+
+    summary(events, dropped, fmt)
+
+
+if __name__ == '__main__':
+    main()
@@ -1,22 +0,0 @@
-/*
- * Copyright (c) 2018-2020, University of Southampton.
- * All rights reserved.
- *
- * SPDX-License-Identifier: BSD-3-Clause
- */
-
-// Voltage dop per byte saved/restored to/from FRAM when no energy is supplied.
-// Generated by generate-dvdb-table.py
-#include <stdint.h>
-
-const uint16_t vdrop[] = {
-    1,   2,   3,   5,   6,   7,   9,   10,  11,  12,  14,  15,  16,  18,  19,
-    20,  21,  23,  24,  25,  27,  28,  29,  30,  32,  33,  34,  36,  37,  38,
-    39,  41,  42,  43,  45,  46,  47,  48,  50,  51,  52,  54,  55,  56,  57,
-    59,  60,  61,  63,  64,  65,  66,  68,  69,  70,  72,  73,  74,  75,  77,
-    78,  79,  81,  82,  83,  84,  86,  87,  88,  90,  91,  92,  93,  95,  96,
-    97,  99,  100, 101, 102, 104, 105, 106, 108, 109, 110, 111, 113, 114, 115,
-    117, 118, 119, 120, 122, 123, 124, 126, 127, 128, 129, 131, 132, 133, 135,
-    136, 137, 138, 140, 141, 142, 144, 145, 146, 147, 149, 150, 151, 153, 154,
-    155, 156, 158, 159, 160, 162, 163, 164,
-};
@@ -1,21 +0,0 @@
-/*
- * Copyright (c) 2018-2020, University of Southampton.
- * All rights reserved.
- *
- * SPDX-License-Identifier: BSD-3-Clause
- */
-
-// Voltage dop per byte saved/restored to/from FRAM when no energy is supplied.
-// Generated by generate-dvdb-table.py
-#include <stdint.h>
-const uint16_t vdrop[] = {
-    2,   4,   7,   9,   11,  14,  16,  18,  21,  23,  25,  28,  30,  32,  35,
-    37,  39,  42,  44,  46,  49,  51,  53,  56,  58,  60,  63,  65,  67,  70,
-    72,  74,  77,  79,  82,  84,  86,  89,  91,  93,  96,  98,  100, 103, 105,
-    107, 110, 112, 114, 117, 119, 121, 124, 126, 128, 131, 133, 135, 138, 140,
-    142, 145, 147, 149, 152, 154, 156, 159, 161, 164, 166, 168, 171, 173, 175,
-    178, 180, 182, 185, 187, 189, 192, 194, 196, 199, 201, 203, 206, 208, 210,
-    213, 215, 217, 220, 222, 224, 227, 229, 231, 234, 236, 238, 241, 243, 246,
-    248, 250, 253, 255, 257, 260, 262, 264, 267, 269, 271, 274, 276, 278, 281,
-    283, 285, 288, 290, 292, 295, 297, 299,
-};
@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019-2020, University of Southampton and Contributors.
+# All rights reserved.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+
+"""
+Generate the vdrop table used by ic_update_thresholds(), and check that the
+worst-case checkpoint of a linked executable fits under VMAX.
+
+Voltage drop per byte is modelled either as linear (--dvdb, default derived
+from DVDT in config.h), or from a capacitor and energy-per-byte model
+(--capacitance, --energy-per-byte), where saving E joules from VON requires
+  dv = sqrt(VON^2 + 2E/C) - VON
+
+Usage:
+  generate-dvdb-table.py table --config config.h --method MS -o dvdb.h
+  generate-dvdb-table.py check --config config.h --method MS \\
+      --size-tool msp430-elf-size --elf app.elf
+"""
+
+import argparse
+import math
+import re
+import subprocess
+import sys
+
+LSB_PER_VOLT = 1024  # Units of VON, VMAX, V_C etc. in config.h
+TABLE_SHIFT = 5      # One table entry per 32 bytes
+
+
+def parse_config(path, method):
+    """Evaluate the #defines in config.h for the given IC method."""
+    defines = {}
+    active = [True]
+    method_macro = {'AS': 'ALLOCATEDSTATE', 'MS': 'MANAGEDSTATE',
+                    'QR': 'QUICKRECALL'}[method]
+    for line in open(path):
+        line = re.sub(r'//.*|/\*.*?\*/', '', line).strip()
+        if line.startswith('#ifdef'):
+            active.append(active[-1] and line.split()[1] == method_macro)
+        elif line.startswith('#ifndef'):
+            active.append(active[-1] and line.split()[1] != method_macro)
+        elif line.startswith('#else'):
+            active[-1] = (not active[-1]) and active[-2]
+        elif line.startswith('#endif'):
+            active.pop()
+        elif line.startswith('#define') and active[-1]:
+            parts = line.split(None, 2)
+            if len(parts) == 3:
+                expr = re.sub(r'\b(0x[0-9a-fA-F]+|\d+)[uUlL]+\b', r'\1',
+                              parts[2])
+                try:
+                    defines[parts[1]] = int(eval(expr, {}, dict(defines)))
+                except Exception:
+                    pass  # Not a numeric constant
+    return defines
+
+
+class Model:
+    def __init__(self, args, cfg):
+        self.von = cfg['VON'] / LSB_PER_VOLT
+        self.capacitance = args.capacitance
+        self.energy_per_byte = args.energy_per_byte
+        if args.dvdb is not None:
+            self.dvdb = args.dvdb
+        else:
+            self.dvdb = cfg['DVDT'] / (LSB_PER_VOLT * 1024)
+        if (self.capacitance is None) != (self.energy_per_byte is None):
+            sys.exit('error: --capacitance and --energy-per-byte go together')
+
+    def vdrop(self, nbytes):
+        """Voltage drop [V] when saving/restoring nbytes without supply."""
+        if self.capacitance is not None:
+            energy = self.energy_per_byte * nbytes
+            return math.sqrt(self.von**2 + 2 * energy / self.capacitance) - \
+                self.von
+        return self.dvdb * nbytes
+
+    def vdrop_adc(self, nbytes):
+        """Voltage drop in ADC LSBs (LSB_PER_VOLT >> 2), as in the table."""
+        return int(self.vdrop(nbytes) * LSB_PER_VOLT) >> 2
+
+
+def emit_table(args, cfg, model):
+    n_entries = -(-args.max_bytes >> TABLE_SHIFT)  # Round up
+    values = [model.vdrop_adc((i + 1) << TABLE_SHIFT)
+              for i in range(n_entries)]
+    out = open(args.output, 'w') if args.output else sys.stdout
+    out.write('// Voltage drop per byte saved/restored to/from FRAM when no '
+              'energy is supplied.\n')
+    out.write('// Generated by generate-dvdb-table.py, do not edit.\n')
+    out.write('#include <stdint.h>\n\n')
+    out.write('#define VDROP_SHIFT {}\n'.format(TABLE_SHIFT))
+    out.write('#define VDROP_LEN {}\n\n'.format(n_entries))
+    out.write('const uint16_t vdrop[VDROP_LEN] = {\n')
+    for i in range(0, n_entries, 15):
+        out.write('    ' + ', '.join(str(v) for v in values[i:i + 15]) +
+                  ',\n')
+    out.write('};\n')
+
+
+def section_sizes(size_tool, elf):
+    """Section sizes of a linked executable, from `size -A -d`."""
+    sizes = {}
+    output = subprocess.check_output([size_tool, '-A', '-d', elf]).decode()
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith('.') and \
+                fields[1].isdigit():
+            sizes[fields[0]] = int(fields[1])
+    return sizes
+
+
+def check_budget(args, cfg, model):
+    sizes = section_sizes(args.size_tool, args.elf)
+
+    def size(*names):
+        return sum(sizes.get(n, 0) for n in names)
+
+    untracked = size('.data', '.lower.data', '.bss', '.lower.bss', '.stack')
+    mmdata = size('.mmdata')
+    if args.method == 'MS':
+        page_size = cfg['PAGE_SIZE']
+        n_pages = -(-mmdata // page_size)
+        max_dirty = min(cfg['MAX_DIRTY_PAGES'], n_pages)
+    else:  # Entire mmdata section is saved and restored
+        page_size = mmdata
+        n_pages = max_dirty = 1 if mmdata else 0
+
+    vmax = cfg['VMAX'] >> 2
+    von = cfg['VON'] >> 2
+    v_c = cfg['V_C'] >> 2
+    # Supply drop within one fast ADC sample period
+    lag = 0 if args.comp_monitor else cfg['ADC_FAST_LAG'] >> 2
+
+    # Suspend saves the dirty pages, restore loads the active ones: with MS,
+    # every page may be active whatever the dirty set.
+    # .ramtext and .ramrodata are copied before waiting for the restore
+    # threshold, they are not part of the restore
+    restore_bytes = untracked + n_pages * page_size
+
+    def thresholds(n_dirty):
+        suspend_bytes = untracked + n_dirty * page_size
+        vs = model.vdrop_adc(suspend_bytes) + von + lag
+        vr = model.vdrop_adc(restore_bytes) + vs + v_c
+        return vs, vr, suspend_bytes
+
+    vs, vr, suspend_bytes = thresholds(max_dirty)
+    name = args.elf.split('/')[-1]
+    print('{}: worst-case suspend {} bytes, restore {} bytes, suspend {:.2f} '
+          'V, restore {:.2f} V, VMAX {:.2f} V'.format(
+              name, suspend_bytes, restore_bytes, 4 * vs / LSB_PER_VOLT,
+              4 * vr / LSB_PER_VOLT, 4 * vmax / LSB_PER_VOLT))
+    if restore_bytes > args.max_bytes:
+        sys.exit('error: {}: restore of {} bytes exceeds vdrop table '
+                 'range of {} bytes'.format(name, restore_bytes,
+                                            args.max_bytes))
+    if vr > vmax:
+        fits = [n for n in range(max_dirty + 1) if thresholds(n)[1] <= vmax]
+        if args.method == 'MS' and fits:
+            # mm_acquire() writes back pages beyond ic_max_dirty_pages()
+            limit = '{}: dirty set limited to {} of MAX_DIRTY_PAGES={} ' \
+                'pages'.format(name, fits[-1], cfg['MAX_DIRTY_PAGES'])
+            if not args.allow_dirty_limit:
+                sys.exit('error: {} (--allow-dirty-limit accepts this)'.format(
+                    limit))
+            print(limit)
+        else:
+            sys.exit('error: {}: worst-case restore threshold exceeds '
+                     'VMAX'.format(name))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+            formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('command', choices=['table', 'check'])
+    parser.add_argument('--config', required=True, help='path to config.h')
+    parser.add_argument('--method', required=True, choices=['AS', 'MS', 'QR'])
+    parser.add_argument('--max-bytes', type=int, default=8192,
+                        help='largest number of bytes covered by the table')
+    parser.add_argument('--dvdb', type=float,
+                        help='linear model: voltage drop per byte [V]')
+    parser.add_argument('--capacitance', type=float,
+                        help='capacitor model: storage capacitance [F]')
+    parser.add_argument('--energy-per-byte', type=float,
+                        help='capacitor model: energy per byte saved [J]')
+    parser.add_argument('-o', '--output', help='table header to write')
+    parser.add_argument('--size-tool', help='toolchain `size` program')
+    parser.add_argument('--elf', help='linked executable to check')
+    parser.add_argument('--comp-monitor', action='store_true',
+                        help='supply monitored by COMP_E (no ADC lag)')
+    parser.add_argument('--page-size', type=int,
+                        help='PAGE_SIZE of the iclib variant, if not config.h')
+    parser.add_argument('--max-dirty-pages', type=int,
+                        help='MAX_DIRTY_PAGES of the iclib variant')
+    parser.add_argument('--allow-dirty-limit', action='store_true',
+                        help='MS: accept a dirty set that VMAX limits below '
+                        'MAX_DIRTY_PAGES')
+    args = parser.parse_args()
+
+    cfg = parse_config(args.config, args.method)
+    if args.page_size:
+        cfg['PAGE_SIZE'] = args.page_size
+    if args.max_dirty_pages:
+        cfg['MAX_DIRTY_PAGES'] = args.max_dirty_pages
+    model = Model(args, cfg)
+
+    if args.command == 'table':
+        emit_table(args, cfg, model)
+    else:
+        if not args.size_tool or not args.elf:
+            parser.error('check needs --size-tool and --elf')
+        check_budget(args, cfg, model)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,274 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019-2020, University of Southampton and Contributors.
+# All rights reserved.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+
+"""
+Order and align the objects in .mmdata so that fewer pages are touched per
+acquire, from an acquire trace or a static affinity hint file.
+
+Each MMDATA object has its own input section (.mmdata.<n>, see ic.h). The
+objects and their input sections are read from the executable (nm) and its
+linker map, and the layout is written as mmdata-order.ld, which the linker
+scripts include at the start of .mmdata.
+
+Acquire trace, addresses of the executable given with --elf, as recorded by
+the host target with ICLIB_MM_TRACE=<file>:
+  A <hex address> <length> [ro|rw]  mm_acquire*(), with the access mode
+  R <hex address> <length>     mm_release*()
+  D <hex address> <length>     mm_discard_array()
+  W                            mm_flush()
+  P                            power failure (suspend and restore)
+  I                            iteration boundary (optional; otherwise an
+                               iteration ends whenever nothing is acquired)
+Only A, R and I are used for the layout, simulate-page-policy.py replays the
+rest too.
+
+Hint file, one group of objects that are acquired together per line:
+  [<weight>:] <symbol> <symbol> ...
+
+Usage:
+  generate-mmdata-layout.py --config config.h --nm msp430-elf-nm \\
+      --elf app.elf --map app.elf.map --trace app.mmtrace -o app-mmdata.ld
+"""
+
+import argparse
+import collections
+import re
+import subprocess
+import sys
+
+Object = collections.namedtuple('Object', 'name addr size section')
+
+
+def read_page_size(path):
+    for line in open(path):
+        m = re.match(r'\s*#define\s+PAGE_SIZE\s+(\d+)', line)
+        if m:
+            return int(m.group(1))
+    sys.exit('error: PAGE_SIZE not found in {}'.format(path))
+
+
+def read_map_sections(path):
+    """Input sections .mmdata.* of a GNU ld map: [(addr, size, pattern)]."""
+    sections = []
+    pending = None
+    for line in open(path):
+        fields = line.split()
+        if len(fields) == 1 and fields[0].startswith('.mmdata.'):
+            pending = fields[0]  # Long name, rest is on the next line
+            continue
+        if pending and len(fields) == 3:
+            fields = [pending] + fields
+        pending = None
+        if len(fields) == 4 and fields[0].startswith('.mmdata.'):
+            addr, size = int(fields[1], 16), int(fields[2], 16)
+            if size:
+                sections.append((addr, size,
+                                 file_pattern(fields[3], fields[0])))
+    return sections
+
+
+def file_pattern(path, section):
+    """Linker script input section description for section of path."""
+    m = re.match(r'(.*)\((.*)\)$', path)  # archive(member)
+    if m:
+        return '*{}:{}({})'.format(m.group(1).split('/')[-1], m.group(2),
+                                   section)
+    return '*/{}({})'.format(path.split('/')[-1], section)
+
+
+def read_objects(args):
+    output = subprocess.check_output([args.nm, '-S', '-n', args.elf])
+    symbols = {}
+    for line in output.decode().splitlines():
+        fields = line.split()
+        if len(fields) == 4:
+            symbols[fields[3]] = (int(fields[0], 16), int(fields[1], 16))
+        elif len(fields) == 3:
+            symbols.setdefault(fields[2], (int(fields[0], 16), 0))
+    if '__mmdata_low' not in symbols:
+        sys.exit('error: {} has no __mmdata_low'.format(args.elf))
+    base = symbols['__mmdata_low'][0]
+
+    objects = []
+    for addr, size, pattern in read_map_sections(args.map):
+        names = [n for n, (a, s) in symbols.items()
+                 if s and addr <= a < addr + size]
+        name = names[0] if len(names) == 1 else pattern
+        objects.append(Object(name, addr - base, size, pattern))
+    return objects, base
+
+
+def read_trace(path, objects, base):
+    """Acquires per iteration, as (object index, offset, length)."""
+    starts = [(o.addr, i) for i, o in enumerate(objects)]
+
+    def locate(addr):
+        for start, i in starts:
+            if start <= addr < start + objects[i].size:
+                return i, addr - start
+        return None
+
+    iterations, current, active = [], [], 0
+    explicit = any(line.strip() == 'I' for line in open(path))
+    for line in open(path):
+        fields = line.split('#')[0].split()
+        if not fields:
+            continue
+        if fields[0] == 'I':
+            iterations.append(current)
+            current = []
+        elif fields[0] in ('A', 'R') and len(fields) >= 3:
+            hit = locate(int(fields[1], 16) - base)
+            if hit is None:
+                continue  # Not in .mmdata, e.g. FRAM_DIRECT
+            if fields[0] == 'A':
+                current.append(hit + (int(fields[2]),))
+                active += 1
+            else:
+                active -= 1
+                if active == 0 and not explicit:
+                    iterations.append(current)
+                    current = []
+    if current:
+        iterations.append(current)
+    return iterations
+
+
+def read_hints(path, objects):
+    """Hint groups as iterations that acquire whole objects."""
+    index = {o.name: i for i, o in enumerate(objects)}
+    iterations = []
+    for line in open(path):
+        line = line.split('#')[0]
+        weight = 1
+        if ':' in line:
+            weight, line = line.split(':', 1)
+            weight = int(weight)
+        group = []
+        for name in line.split():
+            if name not in index:
+                sys.exit('error: {}: no MMDATA object {}'.format(path, name))
+            group.append((index[name], 0, objects[index[name]].size))
+        iterations += [group] * weight
+    return iterations
+
+
+def pages_per_iteration(iterations, layout, page_size):
+    """Mean distinct pages acquired per iteration for a layout {obj: off}.
+    Acquires of objects missing from the layout are ignored."""
+    total = 0
+    for acquires in iterations:
+        pages = set()
+        for i, offset, length in acquires:
+            if i in layout:
+                start = layout[i] + offset
+                pages.update(range(start // page_size,
+                                   (start + max(length, 1) - 1) //
+                                   page_size + 1))
+        total += len(pages)
+    return total / max(len(iterations), 1)
+
+
+def affinity_order(objects, iterations):
+    """Greedy chain: start with the most acquired object, then repeatedly
+    append the one most often acquired together with the last."""
+    n = len(objects)
+    count = [0] * n
+    affinity = collections.defaultdict(int)
+    for acquires in iterations:
+        touched = sorted(set(a[0] for a in acquires))
+        for i in touched:
+            count[i] += 1
+        for x in touched:
+            for y in touched:
+                if x != y:
+                    affinity[x, y] += 1
+
+    order = []
+    remaining = [i for i in range(n) if count[i]]
+    while remaining:
+        last = order[-1] if order else None
+        nxt = max(remaining, key=lambda i: (affinity[last, i], count[i], -i))
+        order.append(nxt)
+        remaining.remove(nxt)
+    return order + [i for i in range(n) if not count[i]]  # Untouched last
+
+
+def place(order, objects, iterations, page_size, align):
+    """Pad each object in turn to the page offset that minimises pages per
+    iteration of the objects placed so far."""
+    layout, padding, cursor = {}, {}, 0
+    for i in order:
+        best = (None, 0)
+        for pad in range(0, page_size, align):
+            layout[i] = cursor + pad
+            cost = pages_per_iteration(iterations, layout, page_size)
+            if best[0] is None or cost < best[0]:
+                best = (cost, pad)
+        layout[i], padding[i] = cursor + best[1], best[1]
+        cursor += best[1] + objects[i].size
+        cursor += -cursor % align
+    return layout, padding
+
+
+def plan(objects, iterations, page_size, align):
+    """Best of link order and affinity order, each with padding."""
+    link_order = sorted(range(len(objects)), key=lambda i: objects[i].addr)
+    plans = []
+    for order in (link_order, affinity_order(objects, iterations)):
+        layout, padding = place(order, objects, iterations, page_size, align)
+        cost = pages_per_iteration(iterations, layout, page_size)
+        plans.append((cost, sum(padding.values()), order, layout, padding))
+    return min(plans, key=lambda p: p[:2])[2:]
+
+
+def write_fragment(path, objects, order, layout, padding):
+    with open(path, 'w') as out:
+        out.write('/* Generated by generate-mmdata-layout.py */\n')
+        for i in order:
+            if padding[i]:
+                out.write('. = __mmdata_low + {};\n'.format(layout[i]))
+            out.write('KEEP({}) /* {} */\n'.format(objects[i].section,
+                                                   objects[i].name))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+            formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--config', required=True, help='path to config.h')
+    parser.add_argument('--nm', required=True, help='toolchain `nm` program')
+    parser.add_argument('--elf', required=True, help='traced executable')
+    parser.add_argument('--map', required=True, help='its linker map')
+    parser.add_argument('--trace', help='acquire trace')
+    parser.add_argument('--hints', help='affinity hint file')
+    parser.add_argument('--align', type=int, default=2,
+                        help='object alignment [bytes]')
+    parser.add_argument('-o', '--output', help='linker script fragment')
+    args = parser.parse_args()
+    if bool(args.trace) == bool(args.hints):
+        parser.error('give one of --trace or --hints')
+
+    page_size = read_page_size(args.config)
+    objects, base = read_objects(args)
+    if args.trace:
+        iterations = read_trace(args.trace, objects, base)
+    else:
+        iterations = read_hints(args.hints, objects)
+
+    order, layout, padding = plan(objects, iterations, page_size, args.align)
+    before = pages_per_iteration(
+        iterations, {i: o.addr for i, o in enumerate(objects)}, page_size)
+    after = pages_per_iteration(iterations, layout, page_size)
+    print('{}: pages per iteration {:.2f} -> {:.2f} ({} padding bytes)'.format(
+        args.elf.split('/')[-1], before, after, sum(padding.values())))
+    if args.output:
+        write_fragment(args.output, objects, order, layout, padding)
+
+
+if __name__ == '__main__':
+    main()
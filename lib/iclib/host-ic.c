@@ -0,0 +1,776 @@
+/*
+ * Copyright (c) 2019-2020, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host (Linux) port of iclib. The application runs on its own stack, and a
+ * timer raises HOST_FAIL_SIGNAL at random intervals as the supply warning.
+ * The signal handler, on an alternate stack, suspends like the other targets,
+ * simulates the power failure by overwriting volatile memory, boots and
+ * restores, then returns to the interrupted code: the kernel restores the
+ * registers from the signal frame, like restore_registers().
+ *
+ * As with the external power supervisor of cm0, suspend is always completed
+ * before power is lost.
+ *
+ * With ICLIB_SUPPLY_TRACE set, failures instead come from replaying a supply
+ * trace through a capacitor model (host-supply.c). The timer then ticks
+ * periodically to advance the model, and suspend/restore follow the
+ * thresholds: suspends or restores that run out of energy fail.
+ *
+ * With ICLIB_STRESS=<n>, one in n (on average) of the ic_stress_point() calls
+ * in iclib also fails: in application code as a regular suspend/restore, in
+ * restore as a loss of power that restarts the restore (once, so that restores
+ * with many stress points still complete). ICLIB_STRESS_SITES
+ * limits this to some sites, e.g. "acquire,restore".
+ *
+ * With ICLIB_MM_TRACE=<file>, the memory manager calls of the application and
+ * the power failures are recorded to <file>, for generate-mmdata-layout.py and
+ * simulate-page-policy.py.
+ *
+ * With IC_TRACE and ICLIB_EVENT_TRACE=<file>, the binary event trace is
+ * written to <file> on exit, for decode-event-trace.py.
+ *
+ * With IC_TIMING, the latency histograms (see ic-timing.c) are in ns of host
+ * time. Restores exclude the failed attempts of ICLIB_STRESS.
+ */
+
+#define _GNU_SOURCE
+#include "lib/iclib/config.h"
+#include "lib/iclib/host-supply.h"
+#include "lib/iclib/ic.h"
+#include "lib/iclib/memory-management.h"
+#include "lib/support/support.h"
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <ucontext.h>
+
+// ------------- CONSTANTS -----------------------------------------------------
+extern uint8_t __stack_low, __stack_high;
+extern uint8_t __data_low, __data_high, __data_loadLow;
+extern uint8_t __bss_low, __bss_high, __bss_loadLow;
+extern uint8_t __mmdata_low, __mmdata_high, __mmdata_loadLow;
+extern uint8_t __sram_hot_low, __sram_hot_high, __sram_hot_loadLow;
+
+#define HOST_NVM __attribute__((section(".host_nvm"))) // Not initialised
+#define POISON 0xA5 // Volatile memory contents after a power failure
+#define SIGNAL_STACK_SIZE 0x10000
+
+// Voltage drop of a transfer [V], see ic_dvdb_model_t
+#define VDROP(bytes) ((double)DVDT * (bytes) / (1024.0 * 1024.0))
+#define V(lsb) ((lsb) / 1024.0) // Thresholds of config.h to volts
+
+#ifdef QUICKRECALL
+#define SUPPLY_I_RUN SUPPLY_I_ACTIVE_QR
+#else
+#define SUPPLY_I_RUN SUPPLY_I_ACTIVE
+#endif
+
+#if defined(__x86_64__)
+#define RED_ZONE 128 // Leaf functions may use memory below the SP
+#define CONTEXT_SP(uc) ((uc)->uc_mcontext.gregs[REG_RSP])
+#elif defined(__aarch64__)
+#define RED_ZONE 0
+#define CONTEXT_SP(uc) ((uc)->uc_mcontext.sp)
+#else
+#error "Host architecture not supported"
+#endif
+
+// ------------- Globals -------------------------------------------------------
+// Failures are not announced in advance
+volatile bool ic_presuspend = false;
+
+// Stack of the application
+static uint8_t app_stack[HOST_STACK_SIZE]
+    __attribute__((section(".host_stack"), aligned(16)));
+
+// ------------- PERSISTENT VARIABLES ------------------------------------------
+
+// Snapshots
+uintptr_t saved_stack_pointer PERSISTENT;
+uint8_t stack_snapshot[HOST_STACK_SIZE] HOST_NVM;
+int snapshotValid PERSISTENT = 0; //! Flag: whether snapshot is valid
+
+// Restore progress
+restore_stage_t restore_stage PERSISTENT = RESTORE_IDLE;
+
+// Checkpoint outcomes
+ic_outcomes_t outcomes PERSISTENT = {0, 0, 0, 0};
+
+// Failure injector, kept outside the simulated SRAM like the power supply
+static ucontext_t boot_context PERSISTENT;
+static ucontext_t app_context PERSISTENT;
+static uint8_t signal_stack[SIGNAL_STACK_SIZE] HOST_NVM;
+static unsigned fail_us PERSISTENT = HOST_FAIL_US;
+static unsigned fail_seed PERSISTENT = 1;
+static unsigned long n_failures PERSISTENT = 0;
+static unsigned long long suspend_bytes PERSISTENT = 0;
+static unsigned long long restore_bytes PERSISTENT = 0;
+
+// Supply trace replay
+static bool supply_mode PERSISTENT = false;
+static double time_scale PERSISTENT = HOST_TIME_SCALE;
+static unsigned tick_us PERSISTENT = HOST_TICK_US;
+static double time_limit PERSISTENT = HOST_SUPPLY_LIMIT;
+static struct timespec last_tick PERSISTENT;
+static double suspend_thr PERSISTENT = 0; //! [V]
+static double restore_thr PERSISTENT = 0; //! [V]
+static double suspend_reserve PERSISTENT = 0; //! [V] see ic_max_dirty_pages
+static double t_run PERSISTENT = 0;       //! Run time since (re)start
+static double t_carry PERSISTENT = 0;     //! Run time past the suspend point
+static double t_wasted PERSISTENT = 0;    //! Run time lost to restarts
+static double t_off PERSISTENT = 0;       //! Time waiting for restore
+static double e_checkpoint PERSISTENT = 0;
+static bool stalled PERSISTENT = false;
+static bool suspend_request PERSISTENT = false; //! Suspend on the next tick
+
+// Stress points
+static unsigned stress_rate PERSISTENT = 0; //! Mean points per failure
+static unsigned stress_seed PERSISTENT = 1;
+static unsigned long stress_failures[IC_STRESS_N] PERSISTENT;
+static bool stress_sites[IC_STRESS_N] PERSISTENT = {true, true, true};
+static const char *stress_site_names[IC_STRESS_N] = {"acquire", "writeback",
+                                                     "restore"};
+static jmp_buf restore_retry PERSISTENT;
+static bool restoring PERSISTENT = false;
+static bool restore_cut PERSISTENT = false; //! Restore already cut short
+static unsigned long long t_handler_ns PERSISTENT = 0; //! Suspend & restore
+static unsigned long long t_wasted_ns PERSISTENT = 0;  //! Failed restores
+
+// Acquire trace (ICLIB_MM_TRACE), muted while suspending and restoring
+static FILE *mm_trace PERSISTENT = NULL;
+static bool mm_trace_mute PERSISTENT = false;
+static unsigned mm_trace_failures PERSISTENT = 0; //! 'P' records to write
+
+#ifdef IC_TRACE
+static FILE *event_trace PERSISTENT = NULL; //! ICLIB_EVENT_TRACE
+#endif
+
+/* ------ Function Prototypes -----------------------------------------------*/
+static unsigned checkpoint(uint8_t *sp);
+static void power_off(void);
+static unsigned power_on(void);
+static unsigned restore(void);
+static unsigned long long now_ns(void);
+static void power_failure(int sig, siginfo_t *info, void *context);
+static void supply_tick(uint8_t *sp);
+static double suspend_voltage(void);
+static double run_time_since_tick(void);
+static unsigned untracked_bytes(void);
+static unsigned device_bytes(unsigned bytes, const uint8_t *sp);
+static void arm_failure_timer(void);
+static void run_app(void);
+static void report(void);
+static void trace_failure(void);
+
+/* ------ Function Declarations ---------------------------------------------*/
+
+__attribute__((constructor)) void iclib_boot(void) {
+  ic_phase_begin(IC_PHASE_BOOT);
+  ic_trace_event(IC_EVENT_BOOT, 0, 0);
+
+  // Program NVM with the initial contents of each section
+  memcpy(&__data_loadLow, &__data_low, &__data_high - &__data_low);
+  memcpy(&__bss_loadLow, &__bss_low, &__bss_high - &__bss_low);
+  memcpy(&__mmdata_loadLow, &__mmdata_low, &__mmdata_high - &__mmdata_low);
+  memcpy(&__sram_hot_loadLow, &__sram_hot_low,
+         &__sram_hot_high - &__sram_hot_low);
+
+  const char *env = getenv("ICLIB_FAIL_US");
+  if (env) {
+    fail_us = strtoul(env, NULL, 0);
+  }
+  env = getenv("ICLIB_FAIL_SEED");
+  if (env) {
+    fail_seed = strtoul(env, NULL, 0);
+  }
+  stress_seed = fail_seed;
+  env = getenv("ICLIB_STRESS");
+  if (env) {
+    stress_rate = strtoul(env, NULL, 0);
+  }
+  env = getenv("ICLIB_STRESS_SITES");
+  if (env) {
+    for (int i = 0; i < IC_STRESS_N; i++) {
+      stress_sites[i] = strstr(env, stress_site_names[i]) != NULL;
+    }
+  }
+  env = getenv("ICLIB_SUPPLY_TRACE");
+  if (env) {
+    if (!supply_open(env)) {
+      fprintf(stderr, "iclib_boot: can't read supply trace %s\n", env);
+      exit(EXIT_FAILURE);
+    }
+    supply_mode = true;
+    if ((env = getenv("ICLIB_TIME_SCALE"))) {
+      time_scale = strtod(env, NULL);
+    }
+    if ((env = getenv("ICLIB_TICK_US"))) {
+      tick_us = strtoul(env, NULL, 0);
+    }
+    if ((env = getenv("ICLIB_SUPPLY_LIMIT"))) {
+      time_limit = strtod(env, NULL);
+    }
+  }
+  env = getenv("ICLIB_MM_TRACE");
+  if (env && !(mm_trace = fopen(env, "w"))) {
+    fprintf(stderr, "iclib_boot: can't write acquire trace %s\n", env);
+    exit(EXIT_FAILURE);
+  }
+#ifdef IC_TRACE
+  env = getenv("ICLIB_EVENT_TRACE");
+  if (env && !(event_trace = fopen(env, "wb"))) {
+    fprintf(stderr, "iclib_boot: can't write event trace %s\n", env);
+    exit(EXIT_FAILURE);
+  }
+#endif
+
+  stack_t ss = {.ss_sp = signal_stack, .ss_size = sizeof(signal_stack)};
+  struct sigaction sa = {.sa_sigaction = power_failure,
+                         .sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESTART};
+  sigemptyset(&sa.sa_mask);
+  if (sigaltstack(&ss, NULL) || sigaction(HOST_FAIL_SIGNAL, &sa, NULL)) {
+    perror("iclib_boot");
+    exit(EXIT_FAILURE);
+  }
+  atexit(report);
+
+  // First power-up: SRAM holds no initial values
+  power_off();
+  power_on();
+
+  getcontext(&app_context);
+  app_context.uc_stack.ss_sp = app_stack;
+  app_context.uc_stack.ss_size = sizeof(app_stack);
+  app_context.uc_link = NULL;
+  makecontext(&app_context, run_app, 0);
+  ic_phase_end(IC_PHASE_BOOT, 0);
+  swapcontext(&boot_context, &app_context); // Does not return
+}
+
+/**
+ * @brief Run the application on its own stack, with failures enabled
+ */
+static void run_app(void) {
+  clock_gettime(CLOCK_MONOTONIC, &last_tick);
+  arm_failure_timer();
+  enable_interrupt();
+  void main(); // Suppress implicit decl. warning
+  main();
+  end_experiment();
+}
+
+/**
+ * @brief Suspend interrupt: save, lose power, boot and restore
+ */
+static void power_failure(int sig, siginfo_t *info, void *context) {
+  if (host_interrupt_deferred()) {
+    return; // enable_interrupt() raises it again, and that run re-arms
+  }
+  ucontext_t *uc = (ucontext_t *)context;
+  uint8_t *sp = (uint8_t *)CONTEXT_SP(uc) - RED_ZONE;
+
+  // Only while the application runs, not in boot code or exit handlers
+  if (sp >= &__stack_low && sp < &__stack_high) {
+    if (supply_mode) {
+      supply_tick(sp);
+    } else {
+      unsigned long long t0 = now_ns();
+      trace_failure();
+      snapshotValid = 0;
+      ic_phase_begin(IC_PHASE_SUSPEND);
+      ic_trace_event(IC_EVENT_SUSPEND, 0, 0);
+      unsigned bytes = checkpoint(sp);
+      ic_phase_end(IC_PHASE_SUSPEND, bytes);
+      ic_trace_event(IC_EVENT_SUSPENDED, 0, bytes);
+      suspend_bytes += bytes;
+      snapshotValid = 1;
+      outcomes.suspend_ok++;
+
+      power_off();
+      restore_bytes += restore();
+      outcomes.restore_ok++;
+      n_failures++;
+      mm_trace_mute = false;
+      t_handler_ns += now_ns() - t0;
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &last_tick);
+  arm_failure_timer();
+  // Returning restores the registers from the signal frame
+}
+
+/**
+ * @brief Advance the supply model by the (scaled) time the application ran
+ * since the last tick, and suspend if the supply is below the suspend
+ * threshold. Then sleep until the restore threshold and restore. If the
+ * suspend ran out of energy, the snapshot is invalid and the application
+ * starts over.
+ * @param sp lowest stack address in use
+ */
+static void supply_tick(uint8_t *sp) {
+  // The supply may cross the suspend threshold within a tick. The run time
+  // past that point is carried over to after the restore.
+  double dt = run_time_since_tick() + t_carry;
+  t_carry = supply_advance(dt, SUPPLY_I_RUN, suspend_voltage());
+  t_run += dt - t_carry;
+  if (supply_voltage() > suspend_voltage() && !suspend_request) {
+    return;
+  }
+  suspend_request = false;
+
+  trace_failure();
+  snapshotValid = 0;
+  ic_phase_begin(IC_PHASE_SUSPEND);
+  ic_trace_event(IC_EVENT_SUSPEND, 0, 0);
+  unsigned bytes = checkpoint(sp);
+  ic_phase_end(IC_PHASE_SUSPEND, bytes);
+  ic_trace_event(IC_EVENT_SUSPENDED, 0, bytes);
+  suspend_bytes += bytes;
+  e_checkpoint += supply_drain(VDROP(device_bytes(bytes, sp)));
+  bool restart = supply_voltage() < V(VON);
+  if (restart) {
+    outcomes.suspend_fail++;
+    t_wasted += t_run; // The carried run time was never supplied
+    t_carry = 0;
+  } else {
+    snapshotValid = 1;
+    outcomes.suspend_ok++;
+  }
+  power_off();
+  n_failures++;
+
+  // Sleep until the restore threshold, retry restores that run out of energy
+  for (;;) {
+    while (supply_voltage() < restore_thr) {
+      supply_advance(SUPPLY_STEP, SUPPLY_I_SLEEP, 0);
+      t_off += SUPPLY_STEP;
+      if (supply_time() > time_limit) {
+        stalled = true;
+        exit(EXIT_FAILURE);
+      }
+    }
+    ic_phase_begin(IC_PHASE_RESTORE);
+    ic_trace_event(IC_EVENT_RESTORE, 0, 0);
+    bytes = power_on();
+    uint8_t *sp_restored =
+        snapshotValid ? (uint8_t *)saved_stack_pointer : &__stack_high;
+    e_checkpoint += supply_drain(VDROP(device_bytes(bytes, sp_restored)));
+    if (supply_voltage() >= V(VON)) {
+      break;
+    }
+    outcomes.restore_fail++;
+    power_off();
+  }
+  ic_phase_end(IC_PHASE_RESTORE, bytes);
+  ic_trace_event(IC_EVENT_RESTORED, 0, bytes);
+  restore_bytes += bytes;
+  mm_trace_mute = false;
+
+  if (restart) { // Boot without a snapshot, i.e. from main()
+    t_run = 0;
+    makecontext(&app_context, run_app, 0);
+    setcontext(&app_context);
+  }
+  outcomes.restore_ok++;
+}
+
+/**
+ * @brief Voltage at which the supply suspends: the suspend threshold, or the
+ * reserve made for a dirty page whose threshold is not set yet
+ */
+static double suspend_voltage(void) {
+  return suspend_reserve > suspend_thr ? suspend_reserve : suspend_thr;
+}
+
+/**
+ * @brief Device time the application ran since the last tick
+ * @return host time scaled by ICLIB_TIME_SCALE [s]
+ */
+static double run_time_since_tick(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return time_scale * ((now.tv_sec - last_tick.tv_sec) +
+                       (now.tv_nsec - last_tick.tv_nsec) * 1e-9);
+}
+
+/**
+ * @brief Save registers and volatile state.
+ * @param sp lowest stack address in use
+ * @return number of bytes saved, including the stack
+ */
+static unsigned checkpoint(uint8_t *sp) {
+  unsigned bytes = 0;
+  memcpy(&__sram_hot_loadLow, &__sram_hot_low,
+         &__sram_hot_high - &__sram_hot_low);
+  bytes += &__sram_hot_high - &__sram_hot_low;
+#if defined(ALLOCATEDSTATE) || defined(MANAGEDSTATE)
+  // Save data, mmdata & stack
+  bytes += mm_flush();
+  memcpy(&__data_loadLow, &__data_low, &__data_high - &__data_low);
+  bytes += &__data_high - &__data_low;
+  memcpy(&__bss_loadLow, &__bss_low, &__bss_high - &__bss_low);
+  bytes += &__bss_high - &__bss_low;
+  saved_stack_pointer = (uintptr_t)sp;
+  memcpy(&stack_snapshot[sp - &__stack_low], sp, &__stack_high - sp);
+  bytes += &__stack_high - sp;
+#elif !defined(QUICKRECALL)
+#error "ICLIB: IC method not defined or invalid."
+#endif
+  mm_stats_checkpoint(bytes);
+  return bytes;
+}
+
+/**
+ * @brief Lose the contents of volatile memory. With QUICKRECALL, only
+ * SRAM_HOT objects are in SRAM.
+ */
+static void power_off(void) {
+  memset(&__sram_hot_low, POISON, &__sram_hot_high - &__sram_hot_low);
+#if defined(ALLOCATEDSTATE) || defined(MANAGEDSTATE)
+  memset(&__data_low, POISON, &__data_high - &__data_low);
+  memset(&__bss_low, POISON, &__bss_high - &__bss_low);
+  memset(&__mmdata_low, POISON, &__mmdata_high - &__mmdata_low);
+  memset(&__stack_low, POISON, &__stack_high - &__stack_low);
+#endif
+}
+
+/**
+ * @brief Boot: restore volatile memory from the last snapshot
+ * @return number of bytes restored
+ */
+static unsigned power_on(void) {
+  unsigned bytes = &__sram_hot_high - &__sram_hot_low;
+  memcpy(&__sram_hot_low, &__sram_hot_loadLow, bytes);
+
+#if defined(ALLOCATEDSTATE) || defined(MANAGEDSTATE)
+  restore_stage = RESTORE_DATA;
+  memcpy(&__data_low, &__data_loadLow, &__data_high - &__data_low);
+  bytes += &__data_high - &__data_low;
+  ic_stress_point(IC_STRESS_RESTORE);
+  restore_stage = RESTORE_BSS;
+  memcpy(&__bss_low, &__bss_loadLow, &__bss_high - &__bss_low);
+  bytes += &__bss_high - &__bss_low;
+  mm_init_lru();
+  restore_stage = RESTORE_MMDATA;
+  mm_restore(false);
+#ifdef ALLOCATEDSTATE
+  bytes += &__mmdata_high - &__mmdata_low;
+#else
+  bytes += mm_get_n_active_pages() * PAGE_SIZE;
+#endif
+  ic_stress_point(IC_STRESS_RESTORE);
+  restore_stage = RESTORE_STACK;
+  if (snapshotValid) {
+    uint8_t *sp = (uint8_t *)saved_stack_pointer;
+    memcpy(sp, &stack_snapshot[sp - &__stack_low], &__stack_high - sp);
+    bytes += &__stack_high - sp;
+  }
+#endif
+
+  restore_stage = RESTORE_IDLE;
+#ifdef MANAGEDSTATE
+  // Thresholds of the restored page set, not the worst case
+  ic_update_thresholds(mm_get_n_dirty_pages() * PAGE_SIZE,
+                       mm_get_n_active_pages() * PAGE_SIZE);
+#else
+  ic_update_thresholds(&__mmdata_high - &__mmdata_low,
+                       &__mmdata_high - &__mmdata_low);
+#endif
+  return bytes;
+}
+
+/**
+ * @brief Restore after a failure, starting over when a stress point cuts the
+ * restore short
+ * @return number of bytes restored by the restore that completed
+ */
+static unsigned restore(void) {
+  static unsigned long long t0 PERSISTENT;
+  t0 = now_ns();
+  restore_cut = false;
+  if (setjmp(restore_retry)) { // Lost power in ic_stress_point()
+    restore_cut = true;
+    outcomes.restore_fail++;
+    t_wasted_ns += now_ns() - t0;
+    t0 = now_ns();
+    power_off();
+  }
+  restoring = true;
+  ic_phase_begin(IC_PHASE_RESTORE);
+  ic_trace_event(IC_EVENT_RESTORE, 0, 0);
+  unsigned bytes = power_on();
+  ic_phase_end(IC_PHASE_RESTORE, bytes);
+  ic_trace_event(IC_EVENT_RESTORED, 0, bytes);
+  restoring = false;
+  return bytes;
+}
+
+void ic_stress_point(ic_stress_site_t site) {
+  // The supply model decides on failures in trace replay
+  if (stress_rate == 0 || supply_mode || !stress_sites[site] ||
+      rand_r(&stress_seed) % stress_rate != 0) {
+    return;
+  }
+  if (restoring) {
+    if (!restore_cut) {
+      stress_failures[site]++;
+      longjmp(restore_retry, 1);
+    }
+  } else if (restore_stage == RESTORE_IDLE && get_interrupt_enable()) {
+    // Application code (not boot or checkpoint): suspend here
+    stress_failures[site]++;
+    raise(HOST_FAIL_SIGNAL);
+  }
+}
+
+void ic_mm_trace(char event, const uint8_t *memPtr, int len, mm_mode mode) {
+  if (mm_trace == NULL || mm_trace_mute) {
+    return;
+  }
+  bool enabled = get_interrupt_enable();
+  disable_interrupt(); // Keep a failure from writing in between
+  for (; mm_trace_failures > 0; mm_trace_failures--) {
+    fputs("P\n", mm_trace);
+  }
+  if (event == 'W') {
+    fputs("W\n", mm_trace);
+  } else if (event == 'A') {
+    fprintf(mm_trace, "A %lx %d %s\n", (unsigned long)(uintptr_t)memPtr, len,
+            mode == MM_READWRITE ? "rw" : "ro");
+  } else {
+    fprintf(mm_trace, "%c %lx %d\n", event, (unsigned long)(uintptr_t)memPtr,
+            len);
+  }
+  if (enabled) {
+    enable_interrupt();
+  }
+}
+
+/**
+ * @brief Record a power failure in the acquire trace, and mute the trace
+ * until the application runs again: mm_flush() and mm_restore() are part of
+ * the failure. Runs in the signal handler, which must not use stdio: the
+ * record is written with the next acquire, or on exit.
+ */
+static void trace_failure(void) {
+  if (mm_trace != NULL) {
+    mm_trace_failures++;
+    mm_trace_mute = true;
+  }
+}
+
+static unsigned long long now_ns(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ull + t.tv_nsec;
+}
+
+#ifdef IC_TIMER
+uint32_t ic_timer_read(void) { return (uint32_t)now_ns(); }
+#endif
+
+/**
+ * @brief Schedule the next failure after a random amount of time, uniform
+ * in [1, 2 * fail_us] us
+ */
+static void arm_failure_timer(void) {
+  unsigned long us;
+  if (supply_mode) {
+    us = tick_us;
+  } else if (fail_us == 0) {
+    return;
+  } else {
+    us = 1 + rand_r(&fail_seed) % (2ul * fail_us);
+  }
+  struct itimerval t = {.it_interval = {0, 0},
+                        .it_value = {us / 1000000, us % 1000000}};
+  setitimer(ITIMER_REAL, &t, NULL);
+}
+
+static void report(void) {
+  struct itimerval off = {{0, 0}, {0, 0}};
+  setitimer(ITIMER_REAL, &off, NULL);
+  for (; mm_trace != NULL && mm_trace_failures > 0; mm_trace_failures--) {
+    fputs("P\n", mm_trace);
+  }
+  fprintf(stderr,
+          "iclib: %lu power failures, %llu bytes suspended, %llu bytes "
+          "restored\n",
+          n_failures, suspend_bytes, restore_bytes);
+#ifdef MM_STATS
+  mm_stats_t mm = mm_get_stats();
+  fprintf(stderr,
+          "iclib-mm: loads=%lu writebacks=%lu lru_evictions=%lu "
+          "forced_evictions=%lu checkpoints=%lu checkpoint_bytes=%lu "
+          "checkpoint_bytes_max=%lu refcnt_peak=%u dirty_peak=%u "
+          "active_peak=%u\n",
+          (unsigned long)mm.loads, (unsigned long)mm.writebacks,
+          (unsigned long)mm.lru_evictions, (unsigned long)mm.forced_evictions,
+          (unsigned long)mm.checkpoints, (unsigned long)mm.checkpoint_bytes,
+          (unsigned long)mm.checkpoint_bytes_max, mm.refcnt_peak,
+          mm.dirty_peak, mm.active_peak);
+#endif
+#ifdef IC_TRACE
+  if (event_trace) {
+    fwrite(&ic_trace, sizeof(ic_trace), 1, event_trace);
+    fclose(event_trace);
+  }
+#endif
+#ifdef IC_TIMING
+  static const char *phase_names[IC_PHASE_N] = {
+      "boot", "restore", "suspend", "flush", "thresholds", "checkpoint"};
+  for (int i = 0; i < IC_PHASE_N; i++) {
+    ic_histogram_t h = ic_timing_get(i);
+    fprintf(stderr,
+            "iclib-timing: phase=%s count=%lu total=%llu max=%lu p50=%lu "
+            "p90=%lu p99=%lu buckets=",
+            phase_names[i], (unsigned long)h.count,
+            (unsigned long long)h.total, (unsigned long)h.max,
+            (unsigned long)ic_timing_percentile(&h, 50),
+            (unsigned long)ic_timing_percentile(&h, 90),
+            (unsigned long)ic_timing_percentile(&h, 99));
+    for (int b = 0; b < IC_TIMING_BUCKETS; b++) {
+      fprintf(stderr, b ? ",%u" : "%u", h.buckets[b]);
+    }
+    fputc('\n', stderr);
+  }
+#endif
+  if (stress_rate) {
+    fprintf(stderr,
+            "iclib-stress: acquire=%lu writeback=%lu restore=%lu "
+            "handler_ns=%llu wasted_ns=%llu\n",
+            stress_failures[IC_STRESS_ACQUIRE],
+            stress_failures[IC_STRESS_WRITEBACK],
+            stress_failures[IC_STRESS_RESTORE], t_handler_ns, t_wasted_ns);
+  }
+  if (supply_mode) {
+    if (!stalled) {
+      supply_advance(run_time_since_tick() + t_carry, SUPPLY_I_RUN, 0);
+    }
+    fprintf(stderr,
+            "iclib-supply: done=%d time=%.6f on=%.6f off=%.6f wasted=%.6f "
+            "suspend_ok=%u suspend_fail=%u restore_ok=%u restore_fail=%u "
+            "e_load=%.9f e_checkpoint=%.9f\n",
+            !stalled, supply_time(), supply_time() - t_off, t_off, t_wasted,
+            outcomes.suspend_ok, outcomes.suspend_fail, outcomes.restore_ok,
+            outcomes.restore_fail, supply_load_energy(), e_checkpoint);
+  }
+}
+
+ic_checkpoint_cost_t ic_checkpoint(void) {
+  ic_checkpoint_cost_t cost;
+  bool enabled = get_interrupt_enable();
+
+  disable_interrupt(); // Don't suspend while checkpointing
+  ic_phase_begin(IC_PHASE_CHECKPOINT);
+  cycle_counter_start();
+  cost.bytes = checkpoint((uint8_t *)__builtin_frame_address(0));
+  cost.cycles = cycle_counter_read();
+  snapshotValid = 1;
+  ic_phase_end(IC_PHASE_CHECKPOINT, cost.bytes);
+  ic_trace_event(IC_EVENT_CHECKPOINT, 0, cost.bytes);
+
+  if (enabled) {
+    enable_interrupt();
+  }
+  return cost;
+}
+
+void ic_update_thresholds(unsigned n_suspend, unsigned n_restore) {
+  ic_phase_begin(IC_PHASE_THRESHOLDS);
+#ifdef QUICKRECALL
+  suspend_thr = V(2048); // Fixed 2V suspend threshold, as on msp430
+  restore_thr = V(2764); // Fixed 2.7V restore threshold
+#else
+  // Same formula as msp430, with the static DVDT model
+  suspend_thr = V(VON) + VDROP(untracked_bytes() + n_suspend);
+  restore_thr = suspend_thr + V(V_C) + VDROP(untracked_bytes() + n_restore);
+  if (restore_thr > V(VMAX)) {
+    ic_trace_event(IC_EVENT_THR_CLIPPED, 0, restore_thr * 1024);
+    restore_thr = V(VMAX);
+  }
+#endif
+  suspend_reserve = 0;
+  ic_trace_event(IC_EVENT_SUSPEND_THR, 0, suspend_thr * 1024);
+  ic_trace_event(IC_EVENT_RESTORE_THR, 0, restore_thr * 1024);
+  ic_phase_end(IC_PHASE_THRESHOLDS, n_suspend);
+}
+
+unsigned ic_max_dirty_pages(unsigned n_restore) {
+  // Without trace replay every suspend completes, see power_failure()
+  if (!supply_mode) {
+    return MAX_DIRTY_PAGES;
+  }
+  double budget = V(VMAX) - V(VON) - V(V_C) -
+                  VDROP(untracked_bytes() + n_restore) -
+                  VDROP(untracked_bytes());
+
+  // The suspend threshold of the grown dirty set must be below the supply,
+  // else the next tick suspends with less energy than the set needs. The
+  // model only advances on ticks, and until mm raises the thresholds, ticks
+  // stop at the reserve for the grown set.
+  bool enabled = get_interrupt_enable();
+  for (;;) {
+    suspend_reserve =
+        V(VON) + VDROP(untracked_bytes() +
+                       (mm_get_n_dirty_pages() + 1) * PAGE_SIZE);
+    if (!enabled || supply_voltage() >= suspend_reserve) {
+      break;
+    }
+    // No room for another dirty page: suspend while the current set fits
+    suspend_request = true;
+    raise(HOST_FAIL_SIGNAL);
+  }
+  double headroom = supply_voltage() - V(VON) - VDROP(untracked_bytes());
+  if (headroom < budget) {
+    budget = headroom;
+  }
+
+  if (budget < 0) {
+    return 0;
+  }
+  unsigned pages = budget / VDROP(PAGE_SIZE);
+  return pages < MAX_DIRTY_PAGES ? pages : MAX_DIRTY_PAGES;
+}
+
+/**
+ * Bytes that are always saved and restored: .data, .bss and the stack (as
+ * budgeted on the device, STACK_SIZE)
+ */
+static unsigned untracked_bytes(void) {
+  return (&__data_high - &__data_low) + (&__bss_high - &__bss_low) +
+         STACK_SIZE;
+}
+
+/**
+ * @brief Bytes the device would save or restore: host stack frames are larger
+ * than on the device, where the stack is budgeted at STACK_SIZE
+ * @param bytes bytes saved or restored, including the stack
+ * @param sp lowest stack address saved or restored
+ */
+static unsigned device_bytes(unsigned bytes, const uint8_t *sp) {
+  unsigned stack = &__stack_high - sp;
+  return stack > STACK_SIZE ? bytes - (stack - STACK_SIZE) : bytes;
+}
+
+bool ic_calibrate(void) {
+  // Not supported: there is no supply voltage to measure
+  return false;
+}
+
+ic_outcomes_t ic_get_outcomes(void) { return outcomes; }
+
+bool ic_restore_should_yield(void) {
+  // Restore runs in the signal handler and is never interrupted
+  return false;
+}
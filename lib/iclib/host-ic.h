@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2019-2020, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef HOST_IC_H
+#define HOST_IC_H
+
+#include <stdint.h>
+#include "lib/iclib/config.h"
+
+// Stack of the application. The boot code runs on the process stack.
+#define HOST_STACK_SIZE 0x10000
+
+// Mean time between simulated power failures [us]. Overridden at run time
+// by the ICLIB_FAIL_US environment variable, 0 disables failures.
+#define HOST_FAIL_US 1000
+
+// Supply trace replay (ICLIB_SUPPLY_TRACE): device time per host time, roughly
+// an 8 MHz MSP430 against a desktop CPU [ICLIB_TIME_SCALE], period of the timer
+// that advances the supply model [us of host time, ICLIB_TICK_US], and the
+// longest replay before giving up on a trace that never reaches the restore
+// threshold [s of device time, ICLIB_SUPPLY_LIMIT]
+#define HOST_TIME_SCALE 100.0
+#define HOST_TICK_US 50
+#define HOST_SUPPLY_LIMIT 600.0
+
+// ic_timer_read() wraps: ns of the monotonic clock (32 bits)
+#define IC_TIMER_MASK 0xFFFFFFFFul
+
+// Boot function, runs as a constructor before the process would enter main()
+void iclib_boot(void);
+
+#endif
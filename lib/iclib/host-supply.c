@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2019-2020, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/***************************** Include Files *********************************/
+#include "lib/iclib/config.h"
+#include "lib/iclib/host-supply.h"
+#include "lib/iclib/ic.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+  double t; //! Start of sample [s]
+  double v; //! Open-circuit voltage [V]
+  double r; //! Source resistance [ohm]
+} sample_t;
+
+/************************** Variable Definitions *****************************/
+
+// The model is outside the simulated SRAM, samples are on the libc heap
+static sample_t *trace PERSISTENT = NULL;
+static unsigned n_samples PERSISTENT = 0;
+static unsigned cursor PERSISTENT = 0; //! Current sample
+static double trace_t PERSISTENT = 0;  //! Time within the trace
+static double time_total PERSISTENT = 0;
+static double v_cap PERSISTENT = VMAX / 1024.0; // Starts charged
+static double e_load PERSISTENT = 0;
+
+/*************************** Function definitions ****************************/
+
+bool supply_open(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return false;
+  }
+
+  unsigned capacity = 0;
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    sample_t s = {0, 0, SUPPLY_R_SOURCE};
+    if (line[0] == '#' || sscanf(line, "%lf %lf %lf", &s.t, &s.v, &s.r) < 2) {
+      continue;
+    }
+    if (n_samples == capacity) {
+      capacity = capacity ? 2 * capacity : 256;
+      trace = realloc(trace, capacity * sizeof(sample_t));
+    }
+    trace[n_samples++] = s;
+  }
+  fclose(f);
+  trace_t = n_samples ? trace[0].t : 0;
+
+  // At least one sample with a duration
+  return n_samples >= 2 && trace[n_samples - 1].t > trace[0].t;
+}
+
+double supply_advance(double dt, double i_load, double v_stop) {
+  const double vmax = VMAX / 1024.0; // Overvoltage clamp
+
+  while (dt > 0 && v_cap >= v_stop) {
+    const sample_t *s = &trace[cursor];
+    double step = trace[cursor + 1].t - trace_t;
+    if (step > SUPPLY_STEP) {
+      step = SUPPLY_STEP;
+    }
+    if (step > dt) {
+      step = dt;
+    }
+
+    bool crossed = false;
+    if (s->v > v_cap) { // Harvester conducts: RC charge towards v_inf
+      double v_inf = s->v - i_load * s->r;
+      double tau = s->r * SUPPLY_CAPACITANCE;
+      double v = v_inf + (v_cap - v_inf) * exp(-step / tau);
+      if (v_stop > 0 && v < v_stop) { // Stop there, as the comparator does
+        step = tau * log((v_cap - v_inf) / (v_stop - v_inf));
+        v = v_stop;
+        crossed = true;
+      }
+      v_cap = v;
+    } else {
+      double v = v_cap - i_load * step / SUPPLY_CAPACITANCE;
+      if (v_stop > 0 && v < v_stop) {
+        step = (v_cap - v_stop) * SUPPLY_CAPACITANCE / i_load;
+        v = v_stop;
+        crossed = true;
+      }
+      v_cap = v;
+    }
+    if (v_cap > vmax) {
+      v_cap = vmax;
+    } else if (v_cap < 0) {
+      v_cap = 0;
+    }
+
+    e_load += v_cap * i_load * step;
+    time_total += step;
+    dt -= step;
+    trace_t += step;
+    while (trace_t >= trace[cursor + 1].t) {
+      if (++cursor == n_samples - 1) { // Repeat
+        cursor = 0;
+        trace_t = trace[0].t;
+      }
+    }
+    if (crossed) {
+      break;
+    }
+  }
+  return dt > 0 ? dt : 0;
+}
+
+double supply_drain(double dv) {
+  double v = (dv < v_cap) ? v_cap - dv : 0;
+  double e = 0.5 * SUPPLY_CAPACITANCE * (v_cap * v_cap - v * v);
+  v_cap = v;
+  return e;
+}
+
+double supply_voltage(void) { return v_cap; }
+
+double supply_time(void) { return time_total; }
+
+double supply_load_energy(void) { return e_load; }
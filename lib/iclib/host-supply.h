@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2019-2020, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef HOST_SUPPLY_H
+#define HOST_SUPPLY_H
+
+#include <stdbool.h>
+
+/* ------ Capacitor model for supply trace replay (host) --------------------*/
+// A harvester with open-circuit voltage from a trace charges the energy store
+// through a source resistance. All values in SI units.
+#define SUPPLY_CAPACITANCE 10e-6 // Energy store [F]
+#define SUPPLY_R_SOURCE 100.0    // Source resistance, unless given by the trace
+#define SUPPLY_I_ACTIVE 1.5e-3   // Load while running AS/MS (SRAM accesses)
+#define SUPPLY_I_ACTIVE_QR 2.2e-3 // Load while running QR (FRAM accesses)
+#define SUPPLY_I_SLEEP 1e-6      // Load while suspended, waiting for restore
+#define SUPPLY_STEP 10e-6        // Integration step [s]
+
+/**
+ * @brief Load a supply trace. Each line is `<time [s]> <open-circuit voltage
+ * [V]> [source resistance [ohm]]`, the voltage holds until the next line. The
+ * last line marks the end of the trace, which then repeats.
+ * @param path trace file
+ * @return false if the trace could not be read
+ */
+bool supply_open(const char *path);
+
+/**
+ * @brief Advance the model, charging from the harvester and discharging
+ * through the load, until the voltage drops to v_stop.
+ * @param dt time [s]
+ * @param i_load load current [A]
+ * @param v_stop voltage at which to stop early, 0 to never stop early [V]
+ * @return time left when stopped early, else 0 [s]
+ */
+double supply_advance(double dt, double i_load, double v_stop);
+
+/**
+ * @brief Remove energy from the store, e.g. for a suspend or restore
+ * @param dv voltage drop [V]
+ * @return energy removed [J]
+ */
+double supply_drain(double dv);
+
+/**
+ * @brief Get the capacitor voltage
+ * @return voltage [V]
+ */
+double supply_voltage(void);
+
+/**
+ * @brief Get the time since the start of the replay
+ * @return time [s]
+ */
+double supply_time(void);
+
+/**
+ * @brief Get the energy drawn by the load, excluding supply_drain()
+ * @return energy [J]
+ */
+double supply_load_energy(void);
+
+#endif
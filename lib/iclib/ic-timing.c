@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2019-2020, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Phases of iclib. The ports mark them with ic_phase_begin()/ic_phase_end(),
+ * which indicate them to the monitor (indicate_phase() in lib/support) and,
+ * with IC_TIMING, keep latency histograms. For these the ports provide
+ * ic_timer_read(): TA1 on msp430, SysTick on cm0 and the monotonic clock on
+ * the host. The histograms are PERSISTENT, so they accumulate over power
+ * failures, and are read with ic_timing_get(), e.g. from a debugger.
+ */
+
+#include "lib/iclib/ic.h"
+#include "lib/support/support.h"
+#include <stdint.h>
+#include <string.h>
+
+#ifdef IC_TIMING
+static ic_histogram_t histograms[IC_PHASE_N] PERSISTENT = {{0}};
+static uint32_t start[IC_PHASE_N] PERSISTENT;
+static uint8_t started PERSISTENT = 0; //! Bit per phase in progress
+
+static void timing_end(ic_phase_t phase);
+#endif
+
+#if defined(IC_TIMING) || defined(SIMULATION) || defined(HOST_ARCH)
+void ic_phase_begin(ic_phase_t phase) {
+  indicate_phase(MONITOR_BOOT_BEGIN + 2 * phase, 0);
+#ifdef IC_TIMING
+  if (phase == IC_PHASE_SUSPEND) {
+    // Phases in progress continue after the restore, but the timer restarts
+    // at boot: drop them, their ic_phase_end() is ignored
+    started = 0;
+  }
+  started |= 1u << phase;
+  start[phase] = ic_timer_read();
+#endif
+}
+
+void ic_phase_end(ic_phase_t phase, uint32_t payload) {
+#ifdef IC_TIMING
+  timing_end(phase);
+#endif
+  indicate_phase(MONITOR_BOOT_END + 2 * phase, payload);
+}
+#endif
+
+#ifdef IC_TIMING
+/**
+ * @brief Add the latency of a phase that ends now to its histogram
+ */
+static void timing_end(ic_phase_t phase) {
+  uint32_t latency = (ic_timer_read() - start[phase]) & IC_TIMER_MASK;
+  if (!(started & (1u << phase))) {
+    return;
+  }
+  started &= ~(1u << phase);
+
+  unsigned bucket = 0;
+  for (uint32_t l = latency >> 1; l && bucket < IC_TIMING_BUCKETS - 1;
+       l >>= 1) {
+    bucket++;
+  }
+  ic_histogram_t *h = &histograms[phase];
+  h->count++;
+  h->total += latency;
+  if (latency > h->max) {
+    h->max = latency;
+  }
+  if (h->buckets[bucket] != UINT16_MAX) {
+    h->buckets[bucket]++;
+  }
+}
+#endif
+
+ic_histogram_t ic_timing_get(ic_phase_t phase) {
+#ifdef IC_TIMING
+  if (phase < IC_PHASE_N) {
+    return histograms[phase];
+  }
+#endif
+  ic_histogram_t none = {0};
+  return none;
+}
+
+uint32_t ic_timing_percentile(const ic_histogram_t *h, unsigned percent) {
+  uint32_t n = 0;
+  for (int i = 0; i < IC_TIMING_BUCKETS; i++) {
+    n += h->buckets[i];
+  }
+
+  // Smallest bucket holding at least percent of the latencies
+  const uint32_t rank = (uint32_t)(((uint64_t)n * percent + 99) / 100);
+  uint32_t seen = 0;
+  for (int i = 0; i < IC_TIMING_BUCKETS - 1; i++) {
+    seen += h->buckets[i];
+    if (seen >= rank && seen > 0) {
+      const uint32_t upper = (2ul << i) - 1;
+      return upper < h->max ? upper : h->max;
+    }
+  }
+  return h->max;
+}
+
+void ic_timing_reset(void) {
+#ifdef IC_TIMING
+  memset(histograms, 0, sizeof(histograms));
+  started = 0;
+#endif
+}
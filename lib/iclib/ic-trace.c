@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2019-2020, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Binary event trace (IC_TRACE). iclib appends fixed-size records, stamped
+ * with the time since the previous record, to a ring buffer in PERSISTENT
+ * memory, so the latest IC_TRACE_SIZE events survive power failures. The host
+ * target writes the buffer to a file (ICLIB_EVENT_TRACE), on the devices it
+ * is dumped from `ic_trace` with a debugger. decode-event-trace.py turns it
+ * into a timeline.
+ *
+ * Without IC_TRACE, ic_trace_event() expands to nothing.
+ */
+
+#include "lib/iclib/ic.h"
+#include <stdint.h>
+
+#ifdef IC_TRACE
+
+#if IC_TRACE_SIZE & (IC_TRACE_SIZE - 1)
+#error "ICLIB: IC_TRACE_SIZE must be a power of two"
+#endif
+
+ic_trace_t ic_trace PERSISTENT = {IC_TRACE_MAGIC, IC_TRACE_SIZE, 0, 0, {{0}}};
+
+/**
+ * @brief Write the next record. A record written by an interrupt between
+ * taking and filling a slot may take the same slot.
+ */
+static void put(uint8_t event, uint8_t arg, uint16_t dt, uint16_t value) {
+  ic_trace_record_t *r = &ic_trace.records[ic_trace.n & (IC_TRACE_SIZE - 1)];
+  ic_trace.n++;
+  r->event = event;
+  r->arg = arg;
+  r->dt = dt;
+  r->value = value;
+}
+
+void ic_trace_event(ic_event_t event, uint8_t arg, uint32_t value) {
+  const uint32_t now = ic_timer_read();
+  uint32_t dt = (now - ic_trace.last) & IC_TIMER_MASK;
+  ic_trace.last = now;
+  if (event == IC_EVENT_BOOT) {
+    dt = 0; // The timer restarted, the time without power is unknown
+  } else if (dt > UINT16_MAX) {
+    put(IC_EVENT_TIME, 0, dt & UINT16_MAX, dt >> 16);
+    dt = 0;
+  }
+  put(event, arg, dt, value > UINT16_MAX ? UINT16_MAX : value);
+}
+
+#endif
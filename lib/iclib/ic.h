@@ -15,12 +15,151 @@
 #include "lib/iclib/msp430-ic.h"
 #elif defined(CM0_ARCH)
 #include "lib/iclib/cm0-ic.h"
+#elif defined(HOST_ARCH)
+#include "lib/iclib/host-ic.h"
 #endif
 
 /* ------ Memory allocation macros ------ */
-#define MMDATA __attribute__((section(".mmdata")))
+// Each MMDATA object gets its own input section, so that the linker can order
+// and align them (see generate-mmdata-layout.py)
+#define MMDATA_SECTION_(n) __attribute__((section(".mmdata." #n)))
+#define MMDATA_SECTION(n) MMDATA_SECTION_(n)
+#define MMDATA MMDATA_SECTION(__COUNTER__)
 #define PERSISTENT __attribute__((section(".persistent")))
 
+// Hybrid placement (HYBRID): SRAM_HOT objects live in SRAM and are part of
+// every checkpoint, also with QUICKRECALL. FRAM_DIRECT objects stay in NVM,
+// are accessed in place and never checkpointed, so they must be read-only or
+// written idempotently. Without HYBRID they are managed like MMDATA.
+#ifdef HYBRID
+#define SRAM_HOT __attribute__((section(".sram_hot")))
+#define FRAM_DIRECT __attribute__((section(".fram_direct")))
+#else
+#define SRAM_HOT
+#define FRAM_DIRECT MMDATA
+#endif
+
+/* ------ Types ------ */
+
+//! Progress of restore(), kept in PERSISTENT memory so that an interrupted
+//! restore can be resumed (or detected and restarted) on the next attempt.
+typedef enum {
+  RESTORE_IDLE = 0, //! No restore in progress
+  RESTORE_DATA,
+  RESTORE_BSS,
+  RESTORE_MMDATA,
+  RESTORE_STACK,
+} restore_stage_t;
+
+//! Per-device model of voltage drop when saving/restoring, in the same units
+//! as DVDT: dv = (dvdt * bytes) / 1024 + offset  [1024 x V]
+typedef struct {
+  uint16_t dvdt;          //! 1024 x voltage delta per byte
+  int16_t offset;         //! Fixed voltage drop per transfer
+  uint16_t cycles_per_kb; //! Transfer time per kilobyte, cycle_counter_read()
+  uint16_t valid;         //! DVDB_MODEL_VALID when calibrated
+} ic_dvdb_model_t;
+
+#define DVDB_MODEL_VALID 0xCA1B
+
+//! Outcome counters of suspends and restores, kept in PERSISTENT memory
+typedef struct {
+  unsigned suspend_ok;   //! Suspends that completed
+  unsigned suspend_fail; //! Suspends cut short by a power failure
+  unsigned restore_ok;   //! Restores that completed
+  unsigned restore_fail; //! Restores cut short by a power failure
+} ic_outcomes_t;
+
+//! Cost of a checkpoint
+typedef struct {
+  unsigned bytes;  //! Bytes written to non-volatile memory
+  uint32_t cycles; //! Time taken, in cycles of cycle_counter_read()
+} ic_checkpoint_cost_t;
+
+//! Points in iclib where the host target can inject a power failure, to stress
+//! suspend/restore at adversarial places (ICLIB_STRESS)
+typedef enum {
+  IC_STRESS_ACQUIRE = 0, //! In mm_acquire(), before updating the attributes
+  IC_STRESS_WRITEBACK,   //! In writePageNvm(), before the critical section
+  IC_STRESS_RESTORE,     //! Between the stages and pages of a restore
+  IC_STRESS_N
+} ic_stress_site_t;
+
+//! Phases of iclib, timed with IC_TIMING and indicated to the monitor. In the
+//! same order as the monitor events (monitor_phase_t in support.h).
+typedef enum {
+  IC_PHASE_BOOT = 0,   //! Reset until state is restored or main() is entered
+  IC_PHASE_RESTORE,    //! Restore of volatile state, until resuming
+  IC_PHASE_SUSPEND,    //! Suspend, until the device can lose power
+  IC_PHASE_FLUSH,      //! mm_flush()
+  IC_PHASE_THRESHOLDS, //! ic_update_thresholds()
+  IC_PHASE_CHECKPOINT, //! ic_checkpoint()
+  IC_PHASE_N
+} ic_phase_t;
+
+#define IC_TIMING_BUCKETS 24
+
+//! Latency histogram of a phase (IC_TIMING), kept in PERSISTENT memory. Times
+//! are in timer cycles of the target (ns on the host). Bucket i counts the
+//! latencies in [2^i, 2^(i+1)), the last bucket also all longer ones.
+typedef struct {
+  uint32_t count; //! Phases timed
+  uint32_t max;   //! Longest latency
+  uint64_t total; //! Sum of the latencies
+  uint16_t buckets[IC_TIMING_BUCKETS]; //! Saturate at UINT16_MAX
+} ic_histogram_t;
+
+//! Events of the binary trace (IC_TRACE), see decode-event-trace.py
+typedef enum {
+  IC_EVENT_TIME = 0,      //! dt: low, value: high 16 bits of a long interval
+  IC_EVENT_BOOT,          //! Timer restarted, dt is 0
+  IC_EVENT_SUSPEND,       //! Suspend started
+  IC_EVENT_SUSPENDED,     //! Suspend done, value: bytes saved
+  IC_EVENT_RESTORE,       //! Restore (re)started
+  IC_EVENT_RESTORED,      //! Restore done, resuming
+  IC_EVENT_CHECKPOINT,    //! ic_checkpoint() done, value: bytes saved
+  IC_EVENT_ACQUIRE,       //! arg: page, value: 1 if read-write
+  IC_EVENT_RELEASE,       //! arg: page
+  IC_EVENT_LOAD,          //! arg: page loaded from NVM
+  IC_EVENT_WRITEBACK,     //! arg: page written back to NVM
+  IC_EVENT_EVICT,         //! arg: page, value: 1 if trickled by pre-suspend
+  IC_EVENT_FLUSH,         //! mm_flush() done, value: bytes written
+  IC_EVENT_SUSPEND_THR,   //! value: suspend threshold [1024 x V]
+  IC_EVENT_RESTORE_THR,   //! value: restore threshold [1024 x V]
+  IC_EVENT_MARK,          //! Application marker, arg and value are free
+  IC_EVENT_THR_CLIPPED,   //! Restore threshold clipped to VMAX, value: needed
+} ic_event_t;
+
+//! Record of the binary trace. dt is the time since the previous record in
+//! cycles of ic_timer_read(), values saturate at UINT16_MAX.
+typedef struct {
+  uint8_t event; //! ic_event_t
+  uint8_t arg;
+  uint16_t dt;
+  uint16_t value;
+} ic_trace_record_t;
+
+#define IC_TRACE_MAGIC 0x1CE7
+
+//! Ring buffer of the binary trace, in PERSISTENT memory
+typedef struct {
+  uint16_t magic; //! IC_TRACE_MAGIC
+  uint16_t size;  //! IC_TRACE_SIZE
+  uint32_t n;     //! Records written, the next one goes to n % size
+  uint32_t last;  //! ic_timer_read() at the last record
+  ic_trace_record_t records[IC_TRACE_SIZE];
+} ic_trace_t;
+
+/* ------ Extern variables ------ */
+
+//! Set while the supply is between the pre-suspend and suspend thresholds
+extern volatile bool ic_presuspend;
+
+#ifdef IC_TRACE
+//! Binary trace, read out by the host target (ICLIB_EVENT_TRACE) or a debugger
+extern ic_trace_t ic_trace;
+#endif
+
 /* ------ Extern functions ------ */
 
 /**
@@ -31,3 +170,156 @@
  * @param n_restore
  */
 void ic_update_thresholds(unsigned n_suspend, unsigned n_restore);
+
+/**
+ * @brief Get the number of dirty pages that can be suspended safely, i.e. such
+ * that the restore threshold stays below VMAX, given the untracked sections,
+ * the voltage drop model and the current guard bands. Bounded by the LRU table
+ * size (MAX_DIRTY_PAGES).
+ *
+ * @param n_restore bytes to be restored (active pages)
+ * @return maximum number of dirty pages
+ */
+unsigned ic_max_dirty_pages(unsigned n_restore);
+
+/**
+ * @brief Take a checkpoint of registers, stack and volatile memory, then
+ * continue execution. Call at cheap points (shallow stack, few dirty pages):
+ * managed pages are written back and become clean, so later suspends only need
+ * to save what changed since.
+ *
+ * @return bytes written and cycles spent, zero when resuming from a restore
+ */
+ic_checkpoint_cost_t ic_checkpoint(void);
+
+/**
+ * @brief Calibrate the voltage-drop-per-byte model used for thresholds, by
+ * timing known-size transfers to FRAM and sampling the supply voltage. The
+ * supply must be disconnected (running from the capacitor only) while this
+ * runs. On success the model is kept in PERSISTENT memory and used by
+ * ic_update_thresholds() instead of the static vdrop tables. iclib never
+ * calls it by itself: it cannot tell whether the supply is disconnected.
+ *
+ * @return true if a plausible model was fitted
+ */
+bool ic_calibrate(void);
+
+/**
+ * @brief Get suspend/restore outcome counters
+ * @return counters accumulated since the device was programmed
+ */
+ic_outcomes_t ic_get_outcomes(void);
+
+/**
+ * @brief Check whether an ongoing restore should stop and wait for the supply
+ * to recover, i.e. the supply has dropped below the suspend threshold.
+ *
+ * @return true if restore should yield
+ */
+bool ic_restore_should_yield(void);
+
+#ifdef HOST_ARCH
+/**
+ * @brief Maybe inject a power failure here. In application code, the failure
+ * is a regular suspend/restore. During a restore, power is lost and the
+ * restore starts over.
+ *
+ * @param site where in iclib the point is
+ */
+void ic_stress_point(ic_stress_site_t site);
+#else
+#define ic_stress_point(site) // Only the host target injects failures
+#endif
+
+#ifdef HOST_ARCH
+/**
+ * @brief Append a memory manager call to the acquire trace, if one is being
+ * recorded (ICLIB_MM_TRACE). See lib/iclib/generate-mmdata-layout.py for the
+ * format.
+ *
+ * @param event 'A' acquire, 'R' release, 'D' discard or 'W' flush
+ * @param memPtr first byte
+ * @param len number of bytes
+ * @param mode access mode of an acquire
+ */
+void ic_mm_trace(char event, const uint8_t *memPtr, int len, mm_mode mode);
+#else
+#define ic_mm_trace(event, memPtr, len, mode) // Only recorded on the host
+#endif
+
+// Phase boundaries are indicated to the monitor in simulation and on the host
+#if defined(IC_TIMING) || defined(SIMULATION) || defined(HOST_ARCH)
+/**
+ * @brief Mark the start of a phase: indicate it to the monitor and start
+ * timing it (IC_TIMING). Starting the suspend drops the phases in progress:
+ * they continue after the restore, on a restarted timer, so they are not
+ * timed.
+ *
+ * @param phase phase that starts now
+ */
+void ic_phase_begin(ic_phase_t phase);
+
+/**
+ * @brief Mark the end of a phase: add its latency to the phase's histogram
+ * (IC_TIMING, ignored unless the phase was started) and indicate it to the
+ * monitor.
+ *
+ * @param phase phase that ends now
+ * @param payload bytes saved, restored or written back, see monitor_phase_t
+ */
+void ic_phase_end(ic_phase_t phase, uint32_t payload);
+#else
+#define ic_phase_begin(phase) // Only marked when timed or monitored
+#define ic_phase_end(phase, payload)
+#endif
+
+#ifdef IC_TRACE
+/**
+ * @brief Append a record to the binary trace, overwriting the oldest one when
+ * the ring buffer is full
+ *
+ * @param event ic_event_t
+ * @param arg page number or 0
+ * @param value payload, saturates at UINT16_MAX
+ */
+void ic_trace_event(ic_event_t event, uint8_t arg, uint32_t value);
+#else
+#define ic_trace_event(event, arg, value) // Only recorded with IC_TRACE
+#endif
+
+// The ports provide a free-running timer for IC_TIMING and IC_TRACE
+#if defined(IC_TIMING) || defined(IC_TRACE)
+#define IC_TIMER
+
+/**
+ * @brief Read the free-running timer of the target, implemented by each port.
+ * Wraps at IC_TIMER_MASK, so phases must be shorter than that.
+ *
+ * @return timer cycles (ns on the host)
+ */
+uint32_t ic_timer_read(void);
+#endif
+
+/**
+ * @brief Get the latency histogram of a phase, all zero unless built with
+ * IC_TIMING
+ *
+ * @param phase phase of iclib
+ * @return histogram since the device was programmed or ic_timing_reset()
+ */
+ic_histogram_t ic_timing_get(ic_phase_t phase);
+
+/**
+ * @brief Upper bound of a percentile of a latency histogram, from the bucket
+ * it falls into
+ *
+ * @param h histogram
+ * @param percent percentile, 0 to 100
+ * @return latency, at most h->max
+ */
+uint32_t ic_timing_percentile(const ic_histogram_t *h, unsigned percent);
+
+/**
+ * @brief Clear the latency histograms
+ */
+void ic_timing_reset(void);
@@ -50,7 +50,7 @@ struct LRU_candidate {
     __enable_interrupt();                                                      \
   } while (0)
 #define IRQ_ENABLED __get_SR_register() & GIE
-#elif defined(CM0_ARCH)
+#elif defined(CM0_ARCH) || defined(HOST_ARCH)
 #define MEMCPY memcpy
 #define IRQ_DISABLE                                                            \
   do {                                                                         \
@@ -63,12 +63,31 @@ struct LRU_candidate {
 #define IRQ_ENABLED get_interrupt_enable()
 #endif
 
+#ifdef MM_STATS
+#define MM_STAT(field, n) (mm_stats.field += (n))
+#define MM_PAGE_STAT(page, field, n) (mm_page_stats[page].field += (n))
+#define MM_PEAK(peak, value)                                                   \
+  do {                                                                         \
+    if ((value) > (peak)) {                                                    \
+      (peak) = (value);                                                        \
+    }                                                                          \
+  } while (0)
+#else
+#define MM_STAT(field, n)
+#define MM_PAGE_STAT(page, field, n)
+#define MM_PEAK(peak, value)
+#endif
+
 /************************** Function Prototypes ******************************/
+static int acquirePage(const uint8_t *memPtr, const mm_mode mode);
+static int releasePage(const uint8_t *memPtr);
 static void writePageNvm(const uint8_t pageNumber);
 static void loadPage(const uint8_t pageNumber);
 static void addLRU(const uint8_t pageNumber);
 static void clearLRU(const uint8_t index);
 static void clearLRUPage(const uint8_t pageNumber);
+static bool is_direct(const uint8_t *memPtr);
+static void updateThresholds(void);
 
 /*************************** Extern Functions ********************************/
 
@@ -77,12 +96,35 @@ static void clearLRUPage(const uint8_t pageNumber);
 static uint8_t attributeTable[NPAGES] = {0};
 static uint8_t lruTable[MAX_DIRTY_PAGES];
 
+//! Page counts the suspend/restore thresholds were last set for
+static int thrDirtyPages = 0;
+static int thrActivePages = 0;
+
+//! Next page to be restored by mm_restore()
+static uint8_t restoreCursor PERSISTENT = 0;
+
+#ifdef MM_STATS
+static mm_stats_t mm_stats PERSISTENT = {0};
+static mm_page_stats_t mm_page_stats[NPAGES] PERSISTENT = {{0}};
+#endif
+
 /*************************** Function definitions ****************************/
 
 int mm_acquire(const uint8_t *memPtr, const mm_mode mode) {
+  ic_mm_trace('A', memPtr, 1, mode);
+  return acquirePage(memPtr, mode);
+}
+
+/**
+ * @brief Acquire the page holding memPtr, mm_acquire() without the trace
+ */
+static int acquirePage(const uint8_t *memPtr, const mm_mode mode) {
 #if defined(ALLOCATEDSTATE) || defined(QUICKRECALL)
   return 0;
 #endif
+  if (is_direct(memPtr)) {
+    return 0;
+  }
   if ((&__mmdata_low > memPtr) || (&__mmdata_high < memPtr)) {
     while (1)
       ; // Error: Pointer out of bounds.
@@ -95,28 +137,37 @@ int mm_acquire(const uint8_t *memPtr, const mm_mode mode) {
       ; // Error: Too many references to a single page
   }
 
-  if (mode == MM_READWRITE) {
-    if (mm_n_dirty_pages >= MAX_DIRTY_PAGES) {
-      // Need to write back an inactive and dirty page first
-      for (int i = MAX_DIRTY_PAGES - 1; i >= 0; i--) {
-        uint8_t candidate = lruTable[i];
-        if (candidate != DUMMY_PAGE) {
-          if ((attributeTable[candidate] & REFCNT_MASK) == 0 &&
-              (attributeTable[candidate] & LOADED) &&
-              (attributeTable[candidate] & MODIFIED)) {
-            writePageNvm(candidate);
-            clearLRU(i);
-            break;
-          }
-        }
-      }
+  if (ic_presuspend && mm_n_dirty_pages > 0) {
+    // Supply is getting low: trickle dirty pages back ahead of suspend
+    mm_writeback_lru();
+  }
 
-      if (mm_n_dirty_pages >= MAX_DIRTY_PAGES) {
-        while (1)
-          ; // Error: MAX_DIRTY_PAGES exceeded
-      }
+  if (mode == MM_READWRITE && !(attributeTable[pageNumber] & MODIFIED)) {
+    // Keep the dirty set within what the energy store can suspend, counting
+    // this page as active
+    int nActive = mm_n_active_pages +
+                  ((attributeTable[pageNumber] & REFCNT_MASK) == 0);
+    int budget = (int)ic_max_dirty_pages(nActive * PAGE_SIZE);
+
+    // Write back inactive dirty pages first (oldest first)
+    while (mm_n_dirty_pages >= budget && mm_writeback_lru() > 0) {
+      MM_STAT(forced_evictions, 1);
     }
 
+    if (mm_n_dirty_pages >= MAX_DIRTY_PAGES) {
+      while (1)
+        ; // Error: LRU table full of active dirty pages
+    }
+  }
+
+  ic_stress_point(IC_STRESS_ACQUIRE);
+
+  // Critical section: a suspend in between would write back a page marked
+  // dirty before it is loaded, and restore would not reload a page that is
+  // loaded but not referenced yet
+  word_t old_gie = IRQ_ENABLED;
+  IRQ_DISABLE;
+  if (mode == MM_READWRITE) {
     if (!(attributeTable[pageNumber] &
           MODIFIED)) { // if page isn't already dirty
       mm_n_dirty_pages++;
@@ -133,28 +184,54 @@ int mm_acquire(const uint8_t *memPtr, const mm_mode mode) {
     mm_n_active_pages++;
   }
   attributeTable[pageNumber]++;
-
-  // Update suspend/restore thresholds
-  static int oldPageTotal = 0;
-  if (oldPageTotal != mm_n_dirty_pages + mm_n_active_pages) {
-    ic_update_thresholds(mm_n_dirty_pages * PAGE_SIZE,
-                         mm_n_active_pages * PAGE_SIZE);
-    oldPageTotal = mm_n_dirty_pages + mm_n_active_pages;
+  MM_PEAK(mm_page_stats[pageNumber].refcnt_peak,
+          attributeTable[pageNumber] & REFCNT_MASK);
+  MM_PEAK(mm_stats.refcnt_peak, attributeTable[pageNumber] & REFCNT_MASK);
+  MM_PEAK(mm_stats.dirty_peak, mm_n_dirty_pages);
+  MM_PEAK(mm_stats.active_peak, mm_n_active_pages);
+
+  // Update suspend/restore thresholds when either page count changed (a
+  // release in between may offset a new dirty page in their sum), before a
+  // suspend can save the new dirty page against the old threshold
+  if (thrDirtyPages != mm_n_dirty_pages ||
+      thrActivePages != mm_n_active_pages) {
+    updateThresholds();
+  }
+  if (old_gie) {
+    IRQ_ENABLE;
   }
+  ic_trace_event(IC_EVENT_ACQUIRE, pageNumber, mode == MM_READWRITE);
 
   return 0;
 }
 
 int mm_release(const uint8_t *memPtr) {
+  ic_mm_trace('R', memPtr, 1, MM_READONLY);
+  return releasePage(memPtr);
+}
+
+/**
+ * @brief Release the page holding memPtr, mm_release() without the trace
+ */
+static int releasePage(const uint8_t *memPtr) {
 #ifndef MANAGEDSTATE
   return 0;
 #endif
+  if (is_direct(memPtr)) {
+    return 0;
+  }
   int pageNumber = ((word_t)memPtr - (word_t)&__mmdata_low) / PAGE_SIZE;
   if ((attributeTable[pageNumber] & REFCNT_MASK) > 0) {
+    word_t old_gie = IRQ_ENABLED;
+    IRQ_DISABLE; // Critical section (suspend updates the attributes too)
     attributeTable[pageNumber]--;
     if ((attributeTable[pageNumber] & REFCNT_MASK) == 0) {
       mm_n_active_pages--;
     }
+    if (old_gie) {
+      IRQ_ENABLE;
+    }
+    ic_trace_event(IC_EVENT_RELEASE, pageNumber, 0);
   } else {
     while (1)
       ; // Error: Attempt to release inactive page
@@ -162,26 +239,70 @@ int mm_release(const uint8_t *memPtr) {
   return 0;
 }
 
-void mm_restore(void) {
+int mm_restore(const bool resume) {
 #if defined(ALLOCATEDSTATE) || defined(QUICKRECALL)
   MEMCPY(&__mmdata_low, &__mmdata_loadLow, &__mmdata_high - &__mmdata_low);
-  return;
+  MM_STAT(bytes_loaded, &__mmdata_high - &__mmdata_low);
+  return 0;
 #endif
 
-  for (int pageNumber = 0; pageNumber < NPAGES; pageNumber++) {
+  if (!resume) {
+    restoreCursor = 0;
+  }
+
+  for (int pageNumber = restoreCursor; pageNumber < NPAGES; pageNumber++) {
+    if (ic_restore_should_yield()) {
+      return NPAGES - pageNumber; // Continue from restoreCursor next time
+    }
+
     // Clear loaded pages (bits are set again when calling loadPage)
     attributeTable[pageNumber] &= ~LOADED;
 
     if ((attributeTable[pageNumber] & REFCNT_MASK) > 0) {
+      ic_stress_point(IC_STRESS_RESTORE);
       loadPage(pageNumber);
     }
+    restoreCursor = pageNumber + 1;
+  }
+
+  restoreCursor = 0;
+  return 0;
+}
+
+int mm_writeback_lru(void) {
+#ifndef MANAGEDSTATE
+  return 0;
+#endif
+  for (int i = MAX_DIRTY_PAGES - 1; i >= 0; i--) {
+    uint8_t candidate = lruTable[i];
+    if (candidate != DUMMY_PAGE) {
+      if ((attributeTable[candidate] & REFCNT_MASK) == 0 &&
+          (attributeTable[candidate] & LOADED) &&
+          (attributeTable[candidate] & MODIFIED)) {
+        writePageNvm(candidate);
+        clearLRU(i);
+        MM_STAT(lru_evictions, 1);
+        MM_PAGE_STAT(candidate, evictions, 1);
+        ic_trace_event(IC_EVENT_EVICT, candidate, ic_presuspend);
+        if (ic_presuspend) { // Lower the suspend threshold as we go
+          updateThresholds();
+        }
+        return PAGE_SIZE;
+      }
+    }
   }
+  return 0;
 }
 
 int mm_flush(void) {
+  ic_mm_trace('W', NULL, 0, MM_READONLY);
+  ic_phase_begin(IC_PHASE_FLUSH);
 #ifndef MANAGEDSTATE
   // Save entire section
   MEMCPY(&__mmdata_loadLow, &__mmdata_low, &__mmdata_high - &__mmdata_low);
+  MM_STAT(bytes_written, &__mmdata_high - &__mmdata_low);
+  ic_phase_end(IC_PHASE_FLUSH, &__mmdata_high - &__mmdata_low);
+  ic_trace_event(IC_EVENT_FLUSH, 0, &__mmdata_high - &__mmdata_low);
   return ((word_t)&__mmdata_high - (word_t)&__mmdata_low);
 #endif
   unsigned pagesSaved = 0;
@@ -198,9 +319,10 @@ int mm_flush(void) {
     }
   }
 
-  ic_update_thresholds(mm_n_dirty_pages * PAGE_SIZE,
-                       mm_n_active_pages * PAGE_SIZE);
+  updateThresholds();
 
+  ic_phase_end(IC_PHASE_FLUSH, pagesSaved * PAGE_SIZE);
+  ic_trace_event(IC_EVENT_FLUSH, 0, pagesSaved * PAGE_SIZE);
   return pagesSaved * PAGE_SIZE;
 }
 
@@ -212,12 +334,17 @@ static void writePageNvm(const uint8_t pageNumber) {
   word_t pageOffset = pageNumber * PAGE_SIZE;
   int len;
 
+  ic_stress_point(IC_STRESS_WRITEBACK);
+  word_t old_gie = IRQ_ENABLED;
+  IRQ_DISABLE; // Critical section (attributes get messed up if interrupted)
+
+  // Checked in the critical section, a suspend may have written it back
   if (!(attributeTable[pageNumber] & MODIFIED)) {
+    if (old_gie) {
+      IRQ_ENABLE;
+    }
     return;
   }
-
-  word_t old_gie = IRQ_ENABLED;
-  IRQ_DISABLE; // Critical section (attributes get messed up if interrupted)
   word_t srcStart = (word_t)&__mmdata_low + pageOffset;
   word_t dstStart = (word_t)(&__mmdata_loadLow) + pageOffset;
   len = PAGE_SIZE;
@@ -227,6 +354,10 @@ static void writePageNvm(const uint8_t pageNumber) {
 
   // Save page
   MEMCPY((uint8_t *)dstStart, (uint8_t *)srcStart, len);
+  MM_STAT(writebacks, 1);
+  MM_STAT(bytes_written, len);
+  MM_PAGE_STAT(pageNumber, writebacks, 1);
+  ic_trace_event(IC_EVENT_WRITEBACK, pageNumber, 0);
 
   if ((attributeTable[pageNumber] & REFCNT_MASK) == 0) {
     // Page is clean
@@ -239,32 +370,36 @@ static void writePageNvm(const uint8_t pageNumber) {
 }
 
 int mm_acquire_array(const uint8_t *memPtr, const int len, const mm_mode mode) {
+  ic_mm_trace('A', memPtr, len, mode);
 #if defined(ALLOCATEDSTATE) || defined(QUICKRECALL)
   return 0;
 #endif
   int status = 0;
-  // Acquire each page referenced
-  const uint8_t *ptr = memPtr;
-  int remaining = len;
-  while (remaining > 0) {
-    status = mm_acquire(ptr, mode);
-    if (remaining > PAGE_SIZE) {
-      ptr += PAGE_SIZE;
-      remaining -= PAGE_SIZE;
-    } else {
-      ptr += remaining;
-      remaining = 0;
-    }
+
+  if (is_direct(memPtr) || len <= 0) {
+    return 0;
+  }
+
+  // Acquire each page referenced, from the first to the last byte
+  word_t first = (memPtr - &__mmdata_low) / PAGE_SIZE;
+  word_t last = (memPtr + len - 1 - &__mmdata_low) / PAGE_SIZE;
+  for (word_t pageNumber = first; pageNumber <= last; pageNumber++) {
+    status = acquirePage(&__mmdata_low + pageNumber * PAGE_SIZE, mode);
   }
   return status;
 }
 
 int mm_release_array(const uint8_t *memPtr, const int len) {
+  ic_mm_trace('R', memPtr, len, MM_READONLY);
 #if defined(ALLOCATEDSTATE) || defined(QUICKRECALL)
   return 0;
 #endif
   int status = 0;
 
+  if (is_direct(memPtr)) {
+    return 0;
+  }
+
   // Error check
   if ((memPtr > &__mmdata_high) || (memPtr < &__mmdata_low) ||
       (memPtr + len) > &__mmdata_high) {
@@ -272,22 +407,70 @@ int mm_release_array(const uint8_t *memPtr, const int len) {
       ; // Error: access out of bounds
   }
 
-  // Release each page referenced
-  const uint8_t *ptr = memPtr;
-  int remaining = len;
-  while (remaining > 0) {
-    status = mm_release(ptr);
-    if (remaining > PAGE_SIZE) {
-      ptr += PAGE_SIZE;
-      remaining -= PAGE_SIZE;
-    } else {
-      ptr += remaining;
-      remaining = 0;
-    }
+  if (len <= 0) {
+    return 0;
+  }
+
+  // Release each page referenced, from the first to the last byte
+  word_t first = (memPtr - &__mmdata_low) / PAGE_SIZE;
+  word_t last = (memPtr + len - 1 - &__mmdata_low) / PAGE_SIZE;
+  for (word_t pageNumber = first; pageNumber <= last; pageNumber++) {
+    status = releasePage(&__mmdata_low + pageNumber * PAGE_SIZE);
   }
   return status;
 }
 
+int mm_discard_array(const uint8_t *memPtr, const int len) {
+  ic_mm_trace('D', memPtr, len, MM_READONLY);
+#ifndef MANAGEDSTATE
+  return 0;
+#endif
+  if ((memPtr < &__mmdata_low) || (memPtr + len) > &__mmdata_high) {
+    while (1)
+      ; // Error: access out of bounds
+  }
+
+  // Only pages entirely within the array
+  word_t offset = memPtr - &__mmdata_low;
+  word_t first = (offset + PAGE_SIZE - 1) / PAGE_SIZE;
+  word_t last = (offset + len) / PAGE_SIZE;
+  int discarded = 0;
+
+  word_t old_gie = IRQ_ENABLED;
+  IRQ_DISABLE; // Critical section (suspend writes back dirty pages)
+  for (word_t pageNumber = first; pageNumber < last; pageNumber++) {
+    if ((attributeTable[pageNumber] & REFCNT_MASK) > 0) {
+      while (1)
+        ; // Error: Attempt to discard active page
+    }
+    if (attributeTable[pageNumber] & MODIFIED) {
+      attributeTable[pageNumber] &= ~MODIFIED;
+      mm_n_dirty_pages--;
+      clearLRUPage(pageNumber);
+      discarded++;
+    }
+  }
+  if (old_gie) {
+    IRQ_ENABLE;
+  }
+
+  if (discarded) {
+    updateThresholds();
+  }
+  return discarded;
+}
+
+/**
+ * @brief Set the suspend/restore thresholds for the current page counts
+ */
+static void updateThresholds(void) {
+  MM_STAT(threshold_updates, 1);
+  ic_update_thresholds(mm_n_dirty_pages * PAGE_SIZE,
+                       mm_n_active_pages * PAGE_SIZE);
+  thrDirtyPages = mm_n_dirty_pages;
+  thrActivePages = mm_n_active_pages;
+}
+
 int mm_get_n_active_pages(void) {
   int nActive = 0;
   for (int i = 0; i < NPAGES; i++) {
@@ -300,11 +483,53 @@ int mm_get_n_active_pages(void) {
 
 int mm_get_n_dirty_pages(void) { return mm_n_dirty_pages; }
 
+mm_stats_t mm_get_stats(void) {
+#ifdef MM_STATS
+  return mm_stats;
+#else
+  mm_stats_t none = {0};
+  return none;
+#endif
+}
+
+mm_page_stats_t mm_get_page_stats(const uint8_t pageNumber) {
+#ifdef MM_STATS
+  if (pageNumber < NPAGES) {
+    return mm_page_stats[pageNumber];
+  }
+#endif
+  mm_page_stats_t none = {0};
+  (void)pageNumber;
+  return none;
+}
+
+void mm_reset_stats(void) {
+#ifdef MM_STATS
+  mm_stats_t none = {0};
+  mm_stats = none;
+  memset(mm_page_stats, 0, sizeof(mm_page_stats));
+#endif
+}
+
+void mm_stats_checkpoint(const unsigned bytes) {
+#ifdef MM_STATS
+  MM_STAT(checkpoints, 1);
+  MM_STAT(checkpoint_bytes, bytes);
+  MM_PEAK(mm_stats.checkpoint_bytes_max, bytes);
+#else
+  (void)bytes;
+#endif
+}
+
 int mm_acquire_page(const uint8_t *memPtr, const int nElements,
                     const int elementSize, mm_mode mode) {
+  ic_mm_trace('A', memPtr, elementSize, mode);
 #if defined(ALLOCATEDSTATE) || defined(QUICKRECALL)
   return nElements;
 #endif
+  if (is_direct(memPtr)) {
+    return nElements;
+  }
   int bytesAcquired;
 
   // Check if first element crosses a page boundary
@@ -317,12 +542,12 @@ int mm_acquire_page(const uint8_t *memPtr, const int nElements,
 
   if (pageNumberStart != pageNumberEnd) {
     // Need to load 2 pages
-    mm_acquire(memPtr, mode);
-    mm_acquire(memPtr + elementSize - 1, mode);
+    acquirePage(memPtr, mode);
+    acquirePage(memPtr + elementSize - 1, mode);
     bytesAcquired = (pageNumberStart + 1) * PAGE_SIZE -
                     (memPtr - &__mmdata_low) + PAGE_SIZE;
   } else {
-    mm_acquire(memPtr, mode);
+    acquirePage(memPtr, mode);
     bytesAcquired =
         (pageNumberStart + 1) * PAGE_SIZE - (memPtr - &__mmdata_low);
   }
@@ -335,6 +560,19 @@ int mm_acquire_page(const uint8_t *memPtr, const int nElements,
   }
 }
 
+/**
+ * @brief Whether memPtr is outside .mmdata and accessed in place, i.e. a
+ * FRAM_DIRECT or SRAM_HOT object with hybrid placement.
+ */
+static bool is_direct(const uint8_t *memPtr) {
+#ifdef HYBRID
+  return (memPtr < &__mmdata_low) || (memPtr >= &__mmdata_high);
+#else
+  (void)memPtr;
+  return false;
+#endif
+}
+
 /**
  * @brief Load page from FRAM if it is not already loaded.
  * @param pageNumber
@@ -351,6 +589,10 @@ static void loadPage(const uint8_t pageNumber) {
 
     MEMCPY(dstStart, srcStart, len);
     attributeTable[pageNumber] |= LOADED;
+    MM_STAT(loads, 1);
+    MM_STAT(bytes_loaded, len);
+    MM_PAGE_STAT(pageNumber, loads, 1);
+    ic_trace_event(IC_EVENT_LOAD, pageNumber, 0);
   }
 }
 
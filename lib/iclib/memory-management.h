@@ -23,6 +23,10 @@ typedef uint16_t *wordptr_t;
 typedef uint32_t addr_t;
 typedef uint32_t word_t;
 typedef uint32_t *wordptr_t;
+#elif defined(HOST_ARCH)
+typedef uintptr_t addr_t;
+typedef uintptr_t word_t;
+typedef uintptr_t *wordptr_t;
 #else
 #error "Target architecture undefined or invalid"
 #endif
@@ -32,6 +36,33 @@ typedef uint32_t *wordptr_t;
 /** Type definitions *********************************************************/
 typedef enum { MM_READONLY, MM_READWRITE } mm_mode;
 
+//! Memory manager counters (MM_STATS), since the last mm_reset_stats(). They
+//! are PERSISTENT: they survive power failures, and count work that is
+//! re-executed after a restore.
+typedef struct {
+  uint32_t loads;             //! Pages loaded from NVM
+  uint32_t writebacks;        //! Pages written back to NVM
+  uint32_t bytes_loaded;      //! Bytes copied from NVM
+  uint32_t bytes_written;     //! Bytes copied to NVM
+  uint32_t threshold_updates; //! Calls to ic_update_thresholds()
+  uint32_t lru_evictions;     //! Pages written back by mm_writeback_lru()
+  uint32_t forced_evictions;  //! Of which to keep within the dirty budget
+  uint32_t checkpoints;       //! Suspends and ic_checkpoint() calls
+  uint32_t checkpoint_bytes;  //! Bytes saved by them
+  uint32_t checkpoint_bytes_max; //! Largest checkpoint
+  uint8_t refcnt_peak;        //! Most references to a page
+  uint8_t dirty_peak;         //! Most dirty pages
+  uint8_t active_peak;        //! Most active pages
+} mm_stats_t;
+
+//! Counters of one page (MM_STATS)
+typedef struct {
+  uint16_t loads;
+  uint16_t writebacks;
+  uint16_t evictions; //! Written back by mm_writeback_lru()
+  uint8_t refcnt_peak;
+} mm_page_stats_t;
+
 /************************** Function Prototypes ******************************/
 
 /**
@@ -65,6 +96,15 @@ int mm_acquire_array(const uint8_t *memPtr, const int len, const mm_mode mode);
  */
 int mm_release_array(const uint8_t *memPtr, const int len);
 
+/**
+ * @brief Drop the whole pages within an array without writing them back, e.g.
+ * when freeing a heap block. The pages must not be acquired.
+ * @param memPtr pointer to first element in array
+ * @param len size of array
+ * @return number of dirty pages dropped
+ */
+int mm_discard_array(const uint8_t *memPtr, const int len);
+
 /**
  * @brief Aquire data from an array one page at a time. May load two pages if
  * the first element of the array crosses a page boundary.
@@ -89,9 +129,13 @@ int mm_get_n_dirty_pages(void);
 void mm_init_lru(void);
 
 /**
- * @brief Restore all active pages to memory from FRAM
+ * @brief Restore all active pages to memory from FRAM. Stops early if
+ * ic_restore_should_yield() returns true, leaving a persistent page cursor
+ * behind.
+ * @param resume continue from the page cursor of an interrupted restore
+ * @return number of pages not yet restored (0 when complete)
  */
-void mm_restore(void);
+int mm_restore(const bool resume);
 
 /**
  * @brief Save all modified pages to FRAM
@@ -99,4 +143,54 @@ void mm_restore(void);
  */
 int mm_flush(void);
 
+/**
+ * @brief Write back the least-recently-used inactive dirty page, if any
+ * @return number of bytes saved
+ */
+int mm_writeback_lru(void);
+
+/**
+ * @brief Get the memory manager counters, all zero unless built with MM_STATS
+ * @return counters since the last mm_reset_stats()
+ */
+mm_stats_t mm_get_stats(void);
+
+/**
+ * @brief Get the counters of one page, all zero unless built with MM_STATS
+ * @param pageNumber page, counted from the start of .mmdata
+ * @return counters since the last mm_reset_stats()
+ */
+mm_page_stats_t mm_get_page_stats(const uint8_t pageNumber);
+
+/**
+ * @brief Reset the memory manager counters, global and per page
+ */
+void mm_reset_stats(void);
+
+/**
+ * @brief Count a checkpoint in the memory manager counters. Called by the
+ * ports on every suspend and ic_checkpoint().
+ * @param bytes bytes saved
+ */
+void mm_stats_checkpoint(const unsigned bytes);
+
+/* ------ Managed heap (mm-heap.c) ----------------------------------------- */
+
+/**
+ * @brief Allocate a block from the managed heap (MM_HEAP_SIZE bytes at the
+ * start of .mmdata). Blocks up to PAGE_SIZE/2 come from size classes that do
+ * not cross pages, larger blocks are page aligned runs of whole pages. Blocks
+ * are accessed through mm_acquire_array()/mm_release_array() like MMDATA.
+ * @param size bytes
+ * @return pointer to block, or NULL if there is no space
+ */
+void *mm_alloc(size_t size);
+
+/**
+ * @brief Return a block to the managed heap. Pages left without blocks are
+ * discarded, so they are never written back. The block must not be acquired.
+ * @param ptr block returned by mm_alloc(), or NULL
+ */
+void mm_free(void *ptr);
+
 #endif /* SRC_MEMORY_MANAGEMENT_H_ */
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2018-2020, University of Southampton.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/***************************** Include Files *********************************/
+#include "lib/iclib/ic.h"
+#include "lib/iclib/memory-management.h"
+#include <stdint.h>
+
+#if MM_HEAP_SIZE > 0
+
+/***************** Macros ****************************************************/
+#define HEAP_PAGES (MM_HEAP_SIZE / PAGE_SIZE)
+
+#if MM_HEAP_SIZE % PAGE_SIZE
+#error MM_HEAP_SIZE must be a multiple of PAGE_SIZE
+#endif
+#if 2 * HEAP_PAGES > PAGE_SIZE
+#error Heap metadata does not fit in a page, reduce MM_HEAP_SIZE
+#endif
+#if HEAP_PAGES > 255
+#error Page indices are 8-bit, reduce MM_HEAP_SIZE or increase PAGE_SIZE
+#endif
+
+// Page map entries. Otherwise an entry is the first page of a block of that
+// many pages (1..MAX_RUN).
+#define PAGE_FREE 0x00
+#define PAGE_CLASS 0x80 //! | size class: page split into small blocks
+#define PAGE_CONT 0xFE  //! Following page of a multi-page block
+#define PAGE_META 0xFF  //! Heap metadata
+#define MAX_RUN 0x7F
+
+// Small block size classes: PAGE_SIZE/8, /4 and /2, at most 8 per page
+#define N_CLASSES 3
+#define CLASS_SIZE(c) (PAGE_SIZE >> (N_CLASSES - (c)))
+#define CLASS_BLOCKS(c) (PAGE_SIZE / CLASS_SIZE(c))
+
+/**************************** Type Definitions *******************************/
+typedef struct {
+  uint8_t page[HEAP_PAGES]; //! Page map
+  uint8_t used[HEAP_PAGES]; //! Bitmap of used blocks of small-block pages
+} heap_meta_t;
+
+/************************** Variable Definitions *****************************/
+
+//! The heap, first in .mmdata so that its pages are managed pages. The
+//! metadata takes page 0, and is paged and checkpointed like the blocks.
+static union {
+  heap_meta_t meta;
+  uint8_t bytes[MM_HEAP_SIZE];
+} heap __attribute__((section(".mmheap"))) = {.meta = {.page = {PAGE_META}}};
+
+/************************** Function Prototypes ******************************/
+static uint8_t find_free_pages(uint8_t n);
+static void *alloc_small(uint8_t c);
+static void *alloc_pages(uint8_t n);
+
+/*************************** Function definitions ****************************/
+
+void *mm_alloc(size_t size) {
+  void *block = NULL;
+  if (size == 0) {
+    return NULL;
+  }
+
+  mm_acquire_array((uint8_t *)&heap.meta, sizeof(heap.meta), MM_READWRITE);
+  if (size <= CLASS_SIZE(N_CLASSES - 1)) {
+    uint8_t c = 0;
+    while (CLASS_SIZE(c) < size) {
+      c++;
+    }
+    block = alloc_small(c);
+  } else if (size <= (size_t)MAX_RUN * PAGE_SIZE) {
+    block = alloc_pages((size + PAGE_SIZE - 1) / PAGE_SIZE);
+  }
+  mm_release_array((uint8_t *)&heap.meta, sizeof(heap.meta));
+
+  return block;
+}
+
+void mm_free(void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+
+  word_t offset = (uint8_t *)ptr - heap.bytes;
+  if ((uint8_t *)ptr < heap.bytes || offset < PAGE_SIZE ||
+      offset >= MM_HEAP_SIZE) {
+    while (1)
+      ; // Error: Not a heap block
+  }
+  uint8_t p = offset / PAGE_SIZE;
+
+  mm_acquire_array((uint8_t *)&heap.meta, sizeof(heap.meta), MM_READWRITE);
+  uint8_t entry = heap.meta.page[p];
+
+  if (entry >= PAGE_CLASS && entry < PAGE_CLASS + N_CLASSES) {
+    uint8_t c = entry - PAGE_CLASS;
+    if (offset % CLASS_SIZE(c) != 0) {
+      while (1)
+        ; // Error: Not the start of a block
+    }
+    uint8_t bit = 1u << ((offset % PAGE_SIZE) / CLASS_SIZE(c));
+    if (!(heap.meta.used[p] & bit)) {
+      while (1)
+        ; // Error: Block is not allocated
+    }
+    heap.meta.used[p] &= ~bit;
+    if (heap.meta.used[p] == 0) { // Last block of the page
+      heap.meta.page[p] = PAGE_FREE;
+      mm_discard_array(&heap.bytes[p * PAGE_SIZE], PAGE_SIZE);
+    }
+  } else if (entry != PAGE_FREE && entry <= MAX_RUN &&
+             offset % PAGE_SIZE == 0) {
+    for (uint8_t i = 0; i < entry; i++) {
+      heap.meta.page[p + i] = PAGE_FREE;
+    }
+    mm_discard_array(&heap.bytes[p * PAGE_SIZE], entry * PAGE_SIZE);
+  } else {
+    while (1)
+      ; // Error: Block is not allocated
+  }
+
+  mm_release_array((uint8_t *)&heap.meta, sizeof(heap.meta));
+}
+
+/**
+ * @brief First fit search for free pages
+ * @param n number of consecutive pages
+ * @return first page, or 0 (the metadata page) if there are none
+ */
+static uint8_t find_free_pages(uint8_t n) {
+  uint8_t run = 0;
+  for (uint8_t p = 1; p < HEAP_PAGES; p++) {
+    run = (heap.meta.page[p] == PAGE_FREE) ? run + 1 : 0;
+    if (run == n) {
+      return p - n + 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Allocate a block of size class c, from a page of that class with a
+ * free block, or else from a new page.
+ */
+static void *alloc_small(uint8_t c) {
+  const uint8_t full = (1u << CLASS_BLOCKS(c)) - 1;
+  uint8_t p;
+
+  for (p = 1; p < HEAP_PAGES; p++) {
+    if (heap.meta.page[p] == PAGE_CLASS + c && heap.meta.used[p] != full) {
+      break;
+    }
+  }
+  if (p == HEAP_PAGES) {
+    p = find_free_pages(1);
+    if (p == 0) {
+      return NULL;
+    }
+    heap.meta.page[p] = PAGE_CLASS + c;
+    heap.meta.used[p] = 0;
+  }
+
+  uint8_t idx = 0;
+  while (heap.meta.used[p] & (1u << idx)) {
+    idx++;
+  }
+  heap.meta.used[p] |= 1u << idx;
+  return &heap.bytes[p * PAGE_SIZE + idx * CLASS_SIZE(c)];
+}
+
+/**
+ * @brief Allocate a page aligned block of n pages.
+ */
+static void *alloc_pages(uint8_t n) {
+  uint8_t p = find_free_pages(n);
+  if (p == 0) {
+    return NULL;
+  }
+  heap.meta.page[p] = n;
+  for (uint8_t i = 1; i < n; i++) {
+    heap.meta.page[p + i] = PAGE_CONT;
+  }
+  return &heap.bytes[p * PAGE_SIZE];
+}
+
+#else // No heap
+
+void *mm_alloc(size_t size) { return NULL; }
+
+void mm_free(void *ptr) {}
+
+#endif
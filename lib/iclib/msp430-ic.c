@@ -13,11 +13,7 @@
 #include <stdint.h>
 
 /* ------ Import voltage threshold tables ------ */
-#ifdef ALLOCATEDSTATE
-#include "dvdb-AS.h"
-#else
-#include "dvdb-MS.h"
-#endif
+#include "dvdb.h" // Generated from config.h by generate-dvdb-table.py
 
 // ------------- CONSTANTS -----------------------------------------------------
 extern uint8_t __stack_low, __stack_high;
@@ -26,20 +22,29 @@ extern uint8_t __data_low, __data_high, __data_loadLow;
 extern uint8_t __mmdata_low, __mmdata_high, __mmdata_loadLow;
 extern uint8_t __boot_stack_high;
 extern uint8_t __npdata_loadLow, __npdata_low, __npdata_high;
+#ifdef QUICKRECALL
+extern uint8_t __sram_hot_low, __sram_hot_high, __sram_hot_loadLow;
+#endif
 
 // ------------- Globals -------------------------------------------------------
 static uint16_t *stackTrunk = (uint16_t *)&__stack_low;
+static unsigned checkpoint_bytes = 0; //! Bytes saved by last suspendVM()
+volatile bool ic_presuspend = false;
 
 // ------------- PERSISTENT VARIABLES ------------------------------------------
 // Restore/suspend thresholds
 uint16_t restore_thr PERSISTENT = 2764 >> 2; // 2.7 V initial value
 uint16_t suspend_thr PERSISTENT = 2355 >> 2; // 2.3 V initial value
+uint16_t presuspend_thr PERSISTENT = (2355 + V_PRESUSPEND) >> 2;
 
 // Snapshots
 uint16_t register_snapshot[15] PERSISTENT;
 uint16_t bss_snapshot[BSS_SIZE] PERSISTENT;
 uint16_t data_snapshot[DATA_SIZE] PERSISTENT;
 uint16_t stack_snapshot[STACK_SIZE] PERSISTENT;
+#ifdef QUICKRECALL
+uint16_t sram_hot_snapshot[SRAM_HOT_SIZE] PERSISTENT;
+#endif
 
 int suspending PERSISTENT;        /*! Flag to determine whether returning from
                                  suspend() or restore() */
@@ -47,11 +52,94 @@ int snapshotValid PERSISTENT = 0; //! Flag: whether snapshot is valid
 int needRestore PERSISTENT = 0;   /*! Flag: whether restore is needed i.e. high
                                      when booting from a power outtage */
 
+// Calibrated voltage drop model and scratch area used to calibrate it
+ic_dvdb_model_t dvdb_model PERSISTENT = {DVDT, 0, 0, 0};
+uint8_t calibration_buffer[CAL_CHUNK] PERSISTENT;
+
+// Restore progress
+restore_stage_t restore_stage PERSISTENT = RESTORE_IDLE;
+
+// Checkpoint outcomes & adaptive guard bands
+typedef struct {
+  int16_t margin;       //! Added to threshold [1024 x V]
+  int16_t min_headroom; //! Smallest headroom seen in current streak
+  uint8_t streak;       //! Consecutive successes
+} guard_band_t;
+
+ic_outcomes_t outcomes PERSISTENT = {0, 0, 0, 0};
+guard_band_t suspend_guard PERSISTENT = {0, INT16_MAX, 0};
+guard_band_t restore_guard PERSISTENT = {0, INT16_MAX, 0};
+int suspend_in_progress PERSISTENT = 0; //! Flag: suspend started, not done
+
 /* ------ Function Prototypes -----------------------------------------------*/
 static void adc_init(void);
+#ifdef COMP_MONITOR
+static void comparator_init(void);
+#endif
 static void gpio_init(void);
 static void clock_init(void);
 static void restore(void);
+static void restore_yield(void);
+static void arm_suspend_monitor(void);
+static uint16_t sample_vcc(void);
+static void guard_update(guard_band_t *g, bool success, int16_t headroom);
+#ifdef DEEP_SLEEP
+static void deep_sleep(void);
+#endif
+static unsigned untracked_bytes(void);
+static uint16_t vdrop_lsb(unsigned nbytes);
+uint16_t calculate_dvdb(size_t nbytes);
+
+#define NPDATA __attribute__((section(".npdata"))) // Not part of snapshot
+
+#ifdef DEEP_SLEEP
+static bool lfxt_running NPDATA = false; //! RTC can wake from LPM3.5
+#endif
+
+/* ------ Dynamic frequency scaling -----------------------------------------*/
+// MCLK = DCO (16 MHz) / 4, 2 or 1. Only DFS_NOMINAL is used without DFS.
+typedef enum { DFS_LOW, DFS_NOMINAL, DFS_HIGH } dfs_level_t;
+
+#ifdef DFS
+static dfs_level_t dfs_level NPDATA = DFS_NOMINAL; //! Current MCLK setting
+#endif
+static void dfs_set(dfs_level_t level);
+static dfs_level_t dfs_running_level(void);
+
+/* ------ Supply monitor ----------------------------------------------------*/
+// Supply voltage is watched either by the ADC12 window comparator (default) or
+// by COMP_E against its resistor ladder (COMP_MONITOR). Both take thresholds
+// in ADC LSBs, i.e. Vcc/256 V.
+typedef enum { MONITOR_NONE, MONITOR_HIGH, MONITOR_LOW } monitor_event_t;
+
+#ifdef COMP_MONITOR
+#define MONITOR_VECTOR COMP_E_VECTOR
+#define COMP_LSB_PER_TAP (COMP_VCC_DIV * 2 * 256 / 32) // 2.0 V ladder, 32 taps
+#define COMP_SETTLE_CYCLES 160 // ~10 us at up to 16 MHz MCLK
+#else
+#define MONITOR_VECTOR ADC12_B_VECTOR
+
+// ADC monitor state, kept out of .bss so that restore() doesn't roll it back
+static uint16_t adc_high NPDATA = 0;     //! Restore threshold
+static uint16_t adc_low NPDATA = 0;      //! (Pre-)suspend threshold
+static bool adc_watch_low NPDATA = false; //! Watching low side (running)
+static bool adc_fast NPDATA = false;      //! Supply close to low threshold
+static bool adc_rate_fast NPDATA = false; //! Current sample rate
+static void adc_program(void);
+#endif
+
+static void monitor_init(void);
+static void monitor_set_thresholds(uint16_t high, uint16_t low);
+static void monitor_set_low(uint16_t low);
+static void monitor_watch_high(void);
+static void monitor_watch_low(void);
+static void monitor_clear_flags(void);
+static bool monitor_below_low(void);
+#ifdef DEEP_SLEEP
+static bool monitor_above_high(void);
+#endif
+static int16_t monitor_headroom(uint16_t limit);
+static monitor_event_t monitor_event(void);
 
 /* ------ ASM functions ---------------------------------------------------- */
 extern void suspend(uint16_t *regSnapshot);
@@ -74,6 +162,11 @@ iclib_boot() {
     *dst++ = *src++;
   }
 
+  // Load hot constant tables
+  extern uint8_t __ramrodata_low, __ramrodata_high, __ramrodata_loadLow;
+  fastmemcpy(&__ramrodata_low, &__ramrodata_loadLow,
+             &__ramrodata_high - &__ramrodata_low);
+
 #ifndef QUICKRECALL
   // Load npdata
   fastmemcpy(&__npdata_low, &__npdata_loadLow, &__npdata_high - &__npdata_low);
@@ -81,8 +174,55 @@ iclib_boot() {
 
   clock_init();
   gpio_init();
-  adc_init();
+#ifdef IC_TIMER
+  TA1CTL = TASSEL__SMCLK | ID__8 | MC__CONTINUOUS | TACLR; // ic_timer_read()
+#endif
+  ic_phase_begin(IC_PHASE_BOOT);
+  ic_trace_event(IC_EVENT_BOOT, 0, 0);
+
+#ifdef DEEP_SLEEP
+  if (PMMIFG & PMMLPM5IFG) { // Woken from LPM3.5 by the RTC
+    RTCCTL0_H = RTCKEY_H;
+    RTCCTL13 |= RTCHOLD;
+    RTCPS1CTL &= ~(RT1PSIE | RT1PSIFG);
+    RTCCTL0_H = 0;
+    PMMCTL0_H = PMMPW_H;
+    PMMIFG &= ~PMMLPM5IFG;
+    PMMCTL0_H = 0;
+  }
+#endif
+
+  if (suspend_in_progress) {
+    // Power failed before the last suspend completed. Suspend earlier.
+    suspend_in_progress = 0;
+    outcomes.suspend_fail++;
+    guard_update(&suspend_guard, false, 0);
+    if (suspend_thr + (GUARD_STEP_UP >> 2) < restore_thr) {
+      suspend_thr += GUARD_STEP_UP >> 2;
+      presuspend_thr += GUARD_STEP_UP >> 2;
+    }
+  }
+
+  if (restore_stage != RESTORE_IDLE) {
+    // Power failed during the previous restore, so SRAM contents are lost and
+    // restore must start over. Require more headroom before trying again.
+    restore_stage = RESTORE_IDLE;
+    outcomes.restore_fail++;
+    guard_update(&restore_guard, false, 0);
+    if (restore_thr + (GUARD_STEP_UP >> 2) <= (VMAX >> 2)) {
+      restore_thr += GUARD_STEP_UP >> 2;
+    }
+  }
+
+  monitor_init();
+
+#ifdef DEEP_SLEEP
+  if (lfxt_running && !monitor_above_high()) {
+    deep_sleep(); // Charge up in LPM3.5, wakes through reset
+  }
+#endif
 
+  ic_phase_end(IC_PHASE_BOOT, 0);
   needRestore = 1;                    // Indicate powerup
   __bis_SR_register(LPM4_bits + GIE); // Enter LPM4 with interrupts enabled
   // Processor sleeps
@@ -98,12 +238,19 @@ iclib_boot() {
 #ifndef QUICKRECALL
   fastmemcpy(&__data_low, &__data_loadLow, &__data_high - &__data_low);
   mm_init_lru();
+#else
+  if ((&__sram_hot_high - &__sram_hot_low) > sizeof(sram_hot_snapshot)) {
+    while (1)
+      ; // Error: SRAM_HOT objects exceed SRAM_HOT_SIZE
+  }
+  fastmemcpy(&__sram_hot_low, &__sram_hot_loadLow,
+             &__sram_hot_high - &__sram_hot_low);
 #endif
 
 #ifdef ALLOCATEDSTATE
   uint16_t mmdata_size = &__mmdata_high - &__mmdata_low;
   ic_update_thresholds(mmdata_size, mmdata_size);
-  mm_restore();
+  mm_restore(false);
 #endif
 
   void main(); // Suppress implicit decl. warning
@@ -157,23 +304,52 @@ static void clock_init(void) {
   // Set ACLK = VLO; MCLK = DCO/2; SMCLK = DCO/2;
   CSCTL2 = SELA_1 + SELS_3 + SELM_3;
   CSCTL3 = DIVA_0 + DIVS_1 + DIVM_1;
+#ifdef DFS
+  dfs_level = DFS_NOMINAL; // .npdata is in FRAM for QuickRecall
+#endif
+
+#ifdef DEEP_SLEEP
+  // LFXT (32 kHz crystal on PJ.4/PJ.5) clocks the RTC wake-up from LPM3.5
+  PJSEL0 |= BIT4 | BIT5;
+  CSCTL4 &= ~LFXTOFF;
+  // Woken from LPM3.5: the crystal was running. Cold boot: wait for it to
+  // start, and wait in LPM4 as without DEEP_SLEEP if it does not.
+  lfxt_running = PMMIFG & PMMLPM5IFG;
+  for (unsigned ms = 0; !lfxt_running && ms < LFXT_START_TIMEOUT; ms++) {
+    CSCTL5 &= ~LFXTOFFG;
+    SFRIFG1 &= ~OFIFG;
+    __delay_cycles(8000); // 1 ms at MCLK = 8 MHz
+    lfxt_running = !(SFRIFG1 & OFIFG);
+  }
+  if (!lfxt_running) {
+    CSCTL4 |= LFXTOFF; // No crystal fitted, or it failed to start
+    CSCTL5 &= ~LFXTOFFG;
+    SFRIFG1 &= ~OFIFG;
+  }
+#endif
 }
 
 void __attribute__((optimize("O0"))) suspendVM(void) {
 #ifdef QUICKRECALL
-  // All state is in FRAM
+  // All state is in FRAM, except SRAM_HOT objects
+  fastmemcpy((uint8_t *)sram_hot_snapshot, &__sram_hot_low,
+             &__sram_hot_high - &__sram_hot_low);
+  checkpoint_bytes = &__sram_hot_high - &__sram_hot_low;
+  mm_stats_checkpoint(checkpoint_bytes);
   suspending = 1;
   return;
 #endif
 
   // Save mmdata
-  mm_flush();
+  checkpoint_bytes = mm_flush();
 
   // bss
   fastmemcpy((uint8_t *)bss_snapshot, &__bss_low, &__bss_high - &__bss_low);
+  checkpoint_bytes += &__bss_high - &__bss_low;
 
   // data
   fastmemcpy((uint8_t *)data_snapshot, &__data_low, &__data_high - &__data_low);
+  checkpoint_bytes += &__data_high - &__data_low;
 
   // stack
   // stack_low-----[SP-------stack_high]
@@ -182,35 +358,260 @@ void __attribute__((optimize("O0"))) suspendVM(void) {
   fastmemcpy((uint8_t *)&stack_snapshot[offset],
              (uint8_t *)register_snapshot[0],
              &__stack_high - (uint8_t *)register_snapshot[0]);
+  checkpoint_bytes += &__stack_high - (uint8_t *)register_snapshot[0];
+  mm_stats_checkpoint(checkpoint_bytes);
 
   suspending = 1;
 }
 
+ic_checkpoint_cost_t __attribute__((optimize("O0"))) ic_checkpoint(void) {
+  ic_checkpoint_cost_t cost = {0, 0};
+  bool gie = get_interrupt_enable();
+
+  __disable_interrupt(); // Don't suspend while checkpointing
+  ic_phase_begin(IC_PHASE_CHECKPOINT);
+  cycle_counter_start();
+  checkpoint_bytes = 0;
+  snapshotValid = 0;
+  suspend_in_progress = 1; // Counts as a failed suspend if power fails
+  suspend(register_snapshot);
+
+  //!! Execution enters this line either:
+  // 1. when returning from suspend(), 2. when returning from restore()
+  if (suspending) { // Checkpoint taken, continue execution
+    snapshotValid = 1;
+    suspend_in_progress = 0;
+    cost.bytes = checkpoint_bytes + sizeof(register_snapshot);
+    cost.cycles = cycle_counter_read();
+    ic_phase_end(IC_PHASE_CHECKPOINT, cost.bytes);
+    ic_trace_event(IC_EVENT_CHECKPOINT, 0, cost.bytes);
+  } else { // Restored from this checkpoint, cost is not meaningful
+    arm_suspend_monitor(); // Back to the running clock, as in the ISR
+    gie = true;
+  }
+
+  if (gie) {
+    __enable_interrupt();
+  }
+  return cost;
+}
+
+/**
+ * Restore volatile state from snapshot. Progress is recorded in restore_stage,
+ * so that if the supply drops during restore, it can yield and continue where
+ * it stopped once the supply has recovered.
+ */
 void __attribute__((optimize("O0"))) restore(void) {
   suspending = 0;
+  ic_phase_begin(IC_PHASE_RESTORE); // TA1 halts while yielding in LPM4
+  ic_trace_event(IC_EVENT_RESTORE, 0, 0);
 
 #ifndef QUICKRECALL
+  // Discard low flag raised while charging up to the restore threshold
+  monitor_set_low(suspend_thr);
+  monitor_clear_flags();
+  dfs_set(DFS_HIGH); // Restore copy at full speed
+
+  const bool resume_mmdata = (restore_stage == RESTORE_MMDATA);
+
+  if (restore_stage == RESTORE_IDLE) {
+    restore_stage = RESTORE_DATA;
+  }
+
   // data
-  fastmemcpy(&__data_low, (uint8_t *)data_snapshot, &__data_high - &__data_low);
+  if (restore_stage == RESTORE_DATA) {
+    fastmemcpy(&__data_low, (uint8_t *)data_snapshot,
+               &__data_high - &__data_low);
+    restore_stage = RESTORE_BSS;
+  }
 
   // bss
-  fastmemcpy(&__bss_low, (uint8_t *)bss_snapshot, &__bss_high - &__bss_low);
+  if (restore_stage == RESTORE_BSS) {
+    if (ic_restore_should_yield()) {
+      restore_yield();
+    }
+    fastmemcpy(&__bss_low, (uint8_t *)bss_snapshot, &__bss_high - &__bss_low);
+    restore_stage = RESTORE_MMDATA;
+  }
 
   // Restore mmdata
-  mm_restore();
+  if (restore_stage == RESTORE_MMDATA) {
+    if (mm_restore(resume_mmdata) > 0) {
+      restore_yield();
+    }
+    restore_stage = RESTORE_STACK;
+  }
 
   // stack -- restore from saved SP to stack_high
   // stack_low-----[SP-------stack_high]
+  if (ic_restore_should_yield()) {
+    restore_yield();
+  }
   uint16_t offset =
       (uint16_t)((uint8_t *)register_snapshot[0] - &__stack_low) / 2;
   fastmemcpy((uint8_t *)register_snapshot[0],
              (uint8_t *)&stack_snapshot[offset],
              &__stack_high - (uint8_t *)register_snapshot[0]);
+  restore_stage = RESTORE_IDLE;
+  outcomes.restore_ok++;
+  guard_update(&restore_guard, true, monitor_headroom(suspend_thr));
+#else
+  fastmemcpy(&__sram_hot_low, (uint8_t *)sram_hot_snapshot,
+             &__sram_hot_high - &__sram_hot_low);
 #endif
 
+  ic_phase_end(IC_PHASE_RESTORE, 0);
+  ic_trace_event(IC_EVENT_RESTORED, 0, 0);
   restore_registers(register_snapshot); // Returns to line after suspend()
 }
 
+/**
+ * Abandon the current restore attempt and sleep until the supply reaches the
+ * restore threshold again. SRAM is retained in LPM4, so the next call to
+ * restore() continues from restore_stage. With DEEP_SLEEP, the device sleeps
+ * in LPM3.5 instead and the restore starts over. Does not return.
+ */
+static void __attribute__((optimize("O0"))) restore_yield(void) {
+#ifdef DEEP_SLEEP
+  if (lfxt_running) {
+    restore_stage = RESTORE_IDLE; // SRAM is lost in LPM3.5, not a failure
+    deep_sleep();
+  }
+#endif
+  needRestore = 1;
+  monitor_clear_flags();
+  monitor_watch_high();
+  __bis_SR_register(LPM4_bits + GIE);
+  while (1)
+    ; // Woken by monitor_isr, which restarts restore() on the boot stack
+}
+
+ic_outcomes_t ic_get_outcomes(void) { return outcomes; }
+
+#ifdef IC_TIMER
+uint32_t ic_timer_read(void) { return (uint32_t)TA1R << 3; }
+#endif
+
+/**
+ * Set MCLK. FRAM needs wait states above 8 MHz, which are added before
+ * speeding up and removed after slowing down.
+ * @param level new MCLK setting
+ */
+static void dfs_set(dfs_level_t level) {
+#ifdef DFS
+  if (level == dfs_level) {
+    return;
+  }
+
+  FRCTL0_H = 0xA5; // Unlock FRAM ctrl
+  if (level == DFS_HIGH) {
+    FRCTL0_L = DFS_HIGH_WAIT << 4;
+  }
+
+  switch (level) {
+  case DFS_LOW:
+    CSCTL3 = DIVA_0 + DIVS_1 + DIVM_2; // MCLK = 4 MHz
+    break;
+  case DFS_NOMINAL:
+    CSCTL3 = DIVA_0 + DIVS_1 + DIVM_1; // MCLK = 8 MHz
+    break;
+  case DFS_HIGH:
+    CSCTL3 = DIVA_0 + DIVS_1 + DIVM_0; // MCLK = 16 MHz
+    break;
+  }
+
+  if (level != DFS_HIGH) {
+    FRCTL0_L = FRAM_WAIT << 4;
+  }
+  dfs_level = level;
+#endif
+}
+
+/**
+ * MCLK setting while running: full speed with plenty of headroom above the
+ * suspend threshold, slow within ADC_SLOW_BAND of it. As the suspend threshold
+ * follows the dirty set, so do the switching points.
+ */
+static dfs_level_t dfs_running_level(void) {
+#ifdef COMP_MONITOR
+  return DFS_NOMINAL; // No supply reading between thresholds
+#else
+  return adc_fast ? DFS_LOW : DFS_HIGH;
+#endif
+}
+
+#ifdef DEEP_SLEEP
+/**
+ * Wait for the supply to recover in LPM3.5 instead of LPM4. All state needed
+ * to resume is in FRAM, so SRAM, the core regulator and the supply monitor can
+ * be switched off. The RTC wakes the device every DEEP_SLEEP_INTERVAL through
+ * a reset into iclib_boot(), which either sleeps again or continues to
+ * restore(). Does not return.
+ */
+static void deep_sleep(void) {
+  // Supply monitor & reference off
+#ifdef COMP_MONITOR
+  CECTL1 &= ~CEON;
+#else
+  ADC12CTL0 &= ~ADC12ENC;
+  ADC12CTL0 &= ~ADC12ON;
+#endif
+  REFCTL0 &= ~REFON;
+
+  // RTC prescaler interrupt: 32768 Hz / 256 / DEEP_SLEEP_INTERVAL
+  RTCCTL0_H = RTCKEY_H; // Unlock RTC
+  RTCCTL13 = RTCHOLD | RTCMODE;
+  RTCPS0CTL = RT0PSDIV_7;                      // LFXT / 256 = 128 Hz
+  RTCPS1CTL = RT1SSEL_2 | DEEP_SLEEP_INTERVAL | // Interval from RT0PS
+              RT1PSIE;
+  RTCCTL13 &= ~RTCHOLD;
+  RTCCTL0_H = 0; // Lock RTC
+
+  PMMCTL0_H = PMMPW_H;     // Unlock PMM
+  PMMCTL0_L |= PMMREGOFF;  // Regulator off: LPM3 becomes LPM3.5
+  __bis_SR_register(LPM3_bits | GIE);
+  while (1)
+    ; // Woken through reset
+}
+#endif
+
+/**
+ * Closed-loop guard band control: widen after a failure, shrink slowly after a
+ * streak of successes that all had headroom to spare.
+ * @param g guard band
+ * @param success whether the suspend/restore completed
+ * @param headroom supply voltage left above the limit on completion
+ */
+static void guard_update(guard_band_t *g, bool success, int16_t headroom) {
+  if (!success) {
+    g->margin += GUARD_STEP_UP;
+    if (g->margin > GUARD_MAX) {
+      g->margin = GUARD_MAX;
+    }
+    g->streak = 0;
+    g->min_headroom = INT16_MAX;
+    return;
+  }
+
+  if (headroom < g->min_headroom) {
+    g->min_headroom = headroom;
+  }
+  if (++g->streak >= GUARD_STREAK) {
+    if (g->min_headroom > GUARD_STEP_DOWN) {
+      g->margin -= GUARD_STEP_DOWN;
+      if (g->margin < GUARD_MIN) {
+        g->margin = GUARD_MIN;
+      }
+    }
+    g->streak = 0;
+    g->min_headroom = INT16_MAX;
+  }
+}
+
+bool ic_restore_should_yield(void) {
+  return (restore_stage != RESTORE_IDLE) && monitor_below_low();
+}
+
 /**
  * Set up ADC in window comparator mode to monitor supply voltage
  */
@@ -248,11 +649,6 @@ static void adc_init(void) {
       ADC12VRSEL_1 | // High reference = REF (2.0V), low reference = AVCC
       ADC12WINC_1;   // Comparator window enable
 
-  // Interrupts
-  ADC12HI = restore_thr;
-  ADC12LO = suspend_thr;
-  ADC12IER2 = ADC12HIIE;
-
   // Configure internal reference
   while (REFCTL0 & REFGENBUSY)
     ;
@@ -264,20 +660,92 @@ static void adc_init(void) {
 
   while (ADC12CTL1 & ADC12BUSY)
     ;
+#ifdef COMP_MONITOR
   ADC12CTL0 |= (ADC12SC | ADC12ENC); // Enable & start conversion
+#else
+  // Wait for restore threshold
+  adc_high = restore_thr;
+#ifdef MANAGEDSTATE
+  adc_low = presuspend_thr;
+#else
+  adc_low = suspend_thr;
+#endif
+  adc_watch_low = false;
+  adc_fast = false;
+  adc_rate_fast = true; // Force reprogramming
+  adc_program();        // Set window & rate, start conversion
+#endif
 }
 
-void __attribute__((__interrupt__(ADC12_B_VECTOR), optimize("O0")))
-adc12_isr(void) {
+#ifndef COMP_MONITOR
+/**
+ * Program the ADC window and sample rate from the monitor state. While
+ * running with more than ADC_SLOW_BAND of headroom, the low side of the
+ * window sits at the edge of the band and the ADC samples slowly (~3 ms).
+ * Inside the band it samples at full rate (~0.2 ms) against the actual
+ * threshold, and the high side detects recovery out of the band. The supply
+ * is always sampled slowly while charging.
+ */
+static void adc_program(void) {
+  const bool fast = adc_watch_low && adc_fast;
+
+  if (fast != adc_rate_fast) {
+    // Stop immediately, the clock divider and sample time can only be
+    // changed while the ADC is stopped
+    ADC12CTL0 &= ~ADC12ENC;
+    ADC12CTL1 &= ~ADC12CONSEQ_3;
+
+    ADC12CTL0 = (ADC12CTL0 & ~ADC12SHT0_15) |
+                (fast ? ADC12SHT0_0   // 4 cycles sample time: ~5 kHz
+                      : ADC12SHT0_2); // 16 cycles sample time
+    ADC12CTL1 = (ADC12CTL1 & ~ADC12DIV_7) | ADC12CONSEQ_2 |
+                (fast ? ADC12DIV_0    // 75 kHz clock
+                      : ADC12DIV_7);  // 9.4 kHz clock: ~300 Hz
+    adc_rate_fast = fast;
+    ADC12IFGR2 = 0; // Flags refer to the previous window
+    ADC12CTL0 |= (ADC12SC | ADC12ENC); // Enable & start conversion
+  }
+
+  if (!adc_watch_low) {
+    ADC12HI = adc_high;
+    ADC12LO = 0;
+    ADC12IER2 = ADC12HIIE;
+  } else if (fast) {
+    ADC12LO = adc_low;
+    ADC12HI = adc_low + ((ADC_SLOW_BAND + ADC_SLOW_BAND / 2) >> 2);
+    ADC12IER2 = ADC12LOIE | ADC12HIIE;
+  } else {
+    ADC12LO = adc_low + (ADC_SLOW_BAND >> 2);
+    ADC12HI = adc_high;
+    ADC12IER2 = ADC12LOIE;
+  }
+}
+
+/**
+ * Switch sample rate when the supply crosses into or out of the band above
+ * the low threshold.
+ * @param fast sample at full rate
+ */
+static void adc_set_fast(bool fast) {
+  adc_fast = fast;
+  adc_program();
+  ADC12IFGR2 = 0;
+  dfs_set(dfs_running_level());
+}
+#endif
+
+
+void __attribute__((__interrupt__(MONITOR_VECTOR), optimize("O0")))
+monitor_isr(void) {
   __disable_interrupt();
 
-  switch (__even_in_range(ADC12IV, ADC12IV__ADC12RDYIFG)) {
-  case ADC12IV__NONE:
-    break;                  // Vector  0:  No interrupt
-  case ADC12IV__ADC12HIIFG: // High Interrupt - Restore
+  switch (monitor_event()) {
+  case MONITOR_NONE:
+    break;           // No interrupt
+  case MONITOR_HIGH: // High Interrupt - Restore
 
     // Disable high interrupt and enable low interrupt
-    ADC12IER2 = ADC12LOIE;
+    monitor_watch_low();
 
     if (needRestore) {
       if (snapshotValid) { // Restore from snapshot
@@ -290,17 +758,32 @@ adc12_isr(void) {
         // Boot in iclib_boot
       }
     } else { // Survived power-outage, no need to restore
+      arm_suspend_monitor();
     }
 
     __bic_SR_register_on_exit(LPM4_bits); // Wake up on return
     break;
-  case ADC12IV__ADC12LOIFG: // Low Interrupt - Suspend
+  case MONITOR_LOW: // Low Interrupt - Pre-suspend or suspend
+
+#ifdef MANAGEDSTATE
+    if (!ic_presuspend) {
+      // Early warning: start trickle writeback of dirty pages (in
+      // mm_acquire()) and move the window down to the suspend threshold
+      ic_presuspend = true;
+      monitor_set_low(suspend_thr);
+      break;
+    }
+#endif
 
     // Disable low interrupt and enable high
-    ADC12IER2 = ADC12HIIE;
+    monitor_watch_high();
 
     P1OUT |= BIT4;
     snapshotValid = 0;
+    suspend_in_progress = 1;
+    dfs_set(DFS_HIGH); // Suspend copy at full speed
+    ic_phase_begin(IC_PHASE_SUSPEND);
+    ic_trace_event(IC_EVENT_SUSPEND, 0, 0);
     suspend(register_snapshot);
     P1OUT &= ~(BIT3 | BIT4);
 
@@ -308,13 +791,24 @@ adc12_isr(void) {
     // 1. when returning from suspend(), 2. when returning from
     // restore()
     if (suspending) { // Returning from suspend(), go to sleep
+      ic_phase_end(IC_PHASE_SUSPEND, checkpoint_bytes);
+      ic_trace_event(IC_EVENT_SUSPENDED, 0, checkpoint_bytes);
       snapshotValid = 1;
+      suspend_in_progress = 0;
+      outcomes.suspend_ok++;
+      guard_update(&suspend_guard, true, monitor_headroom(VON >> 2));
       // P1OUT &= ~BIT5; // Clear active
       // P6REN &= ~BIT0;  // Disable pull-up
       P1OUT = 0;                            // Clear IO
       P6OUT &= ~BIT0;                       // De-assert keep-alive
+#ifdef DEEP_SLEEP
+      if (lfxt_running) {
+        deep_sleep(); // Wakes through reset, then iclib_boot restores
+      }
+#endif
       __bis_SR_register_on_exit(LPM4_bits); // Sleep on return
     } else { // Returning from Restore(), continue execution
+      arm_suspend_monitor();
       __bic_SR_register_on_exit(LPM4_bits); // Wake up on return
     }
     break;
@@ -322,10 +816,24 @@ adc12_isr(void) {
     break;
   }
 
-  ADC12IFGR2 = 0;                 // Clear Interrupt flags
+  monitor_clear_flags();           // Clear Interrupt flags
   __bis_SR_register_on_exit(GIE); // enable global interrupts
 }
 
+/**
+ * Re-arm the low side of the window comparator after a restore or a survived
+ * outage: pre-suspend threshold first (ManagedState), then suspend threshold.
+ */
+static void arm_suspend_monitor(void) {
+  ic_presuspend = false;
+#ifdef MANAGEDSTATE
+  monitor_set_low(presuspend_thr);
+#else
+  monitor_set_low(suspend_thr);
+#endif
+  dfs_set(dfs_running_level());
+}
+
 // Port 5 interrupt service routine
 void __attribute__((__interrupt__(PORT5_VECTOR))) port5_isr_handler(void) {
   __disable_interrupt();
@@ -363,86 +871,487 @@ void __attribute__((__interrupt__(PORT5_VECTOR))) port5_isr_handler(void) {
 void ic_update_thresholds(unsigned n_suspend, unsigned n_restore) {
   static unsigned suspend_old = 0;
   static unsigned restore_old = 0;
-  static unsigned untracked = 0;
 
 #ifdef QUICKRECALL
-  ADC12HI = 2764 >> 2; // Fixed 2.7V restore threshold
-  ADC12LO = 2048 >> 2; // Fixed 2V suspend threshold
+  monitor_set_thresholds(2764 >> 2, // Fixed 2.7V restore threshold
+                         2048 >> 2  // Fixed 2V suspend threshold
+  );
   return;
 #endif
 
-  if (untracked == 0) { // Hack to calculate this once. Ideally should be a
-                        // const calculated by the compiler/preprocessor
-    untracked =
-        (unsigned)((&__data_high - &__data_low) + (&__bss_high - &__bss_low) +
-                   (&__stack_high - &__stack_low));
-  }
-
   if (n_suspend == suspend_old && n_restore == restore_old) {
     return; // No need for updates
   }
+  ic_phase_begin(IC_PHASE_THRESHOLDS);
 
   // Formula:
   // newVS = V_ON + (factor*bytes_to_save)/1024
   // newVR = newVS + V_C + factor*bytes_to_restore/1024
 
-  /*
-  If you don't want to use tables for vdrop
-  uint16_t newVS = (calculate_dvdb(untracked + n_suspend) + VON) >> 2;
-  uint16_t newVR = (calculate_dvdb(untracked + n_restore) + newVS + V_C) >> 2;
-  */
+  uint16_t dvS = vdrop_lsb(untracked_bytes() + n_suspend);
+  // The boot copies (.ramtext, .ramrodata) run at reset, before the wait for
+  // the restore threshold, so they don't draw on the restore budget
+  uint16_t dvR = vdrop_lsb(untracked_bytes() + n_restore);
+  if (dvS == UINT16_MAX || dvR == UINT16_MAX) {
+    while (1)
+      ; // Error: Checkpoint larger than vdrop table, see
+        // ICLIB_MAX_STATE_BYTES
+  }
 
-  uint16_t newVS = vdrop[(untracked + n_suspend) >> 5] + (VON >> 2);
-  uint16_t newVR = vdrop[(untracked + n_restore) >> 5] + newVS + (V_C >> 2);
+  uint16_t newVS = dvS + (VON >> 2);
+#ifndef COMP_MONITOR
+  newVS += ADC_FAST_LAG >> 2; // Supply drop within one fast ADC sample period
+#endif
+  uint16_t newVR = dvR + newVS + (V_C >> 2);
 
+  // Guard bands adapted from suspend/restore outcomes
+  newVS += suspend_guard.margin / 4;
+  newVR += suspend_guard.margin / 4;
+  newVR += restore_guard.margin / 4;
+
+  // The dirty set is kept within ic_max_dirty_pages(), so this only clips
+  // when more pages are held active than the energy store can protect. The
+  // restore then cannot be covered: record the threshold it needed.
   if (newVR > (VMAX >> 2)) {
-    while (1)
-      ; // Error: No safe restore thr found
+    ic_trace_event(IC_EVENT_THR_CLIPPED, 0, (uint32_t)newVR << 2);
+    newVR = VMAX >> 2;
+  }
+
+  // Pre-suspend threshold, kept below the restore threshold
+  uint16_t newVP = newVS + (V_PRESUSPEND >> 2);
+  if (newVP > newVR) {
+    newVP = newVR;
   }
 
   restore_thr = newVR;
   suspend_thr = newVS;
+  presuspend_thr = newVP;
+  ic_trace_event(IC_EVENT_SUSPEND_THR, 0, (uint32_t)newVS << 2);
+  ic_trace_event(IC_EVENT_RESTORE_THR, 0, (uint32_t)newVR << 2);
+
+#ifdef MANAGEDSTATE
+  monitor_set_thresholds(newVR, ic_presuspend ? newVS : newVP);
+#else
+  monitor_set_thresholds(newVR, newVS);
+#endif
+  ic_phase_end(IC_PHASE_THRESHOLDS, n_suspend);
+}
+
+unsigned ic_max_dirty_pages(unsigned n_restore) {
+#ifdef MANAGEDSTATE
+  uint16_t dvR = vdrop_lsb(untracked_bytes() + n_restore);
+  if (dvR == UINT16_MAX) {
+    return 0; // Restore beyond the vdrop table, nothing fits
+  }
 
-  ADC12HI = newVR;
-  ADC12LO = newVS;
+  // Room left for dvS under VMAX, with the terms of ic_update_thresholds()
+  int16_t budget = (VMAX >> 2) - (VON >> 2);
+#ifndef COMP_MONITOR
+  budget -= ADC_FAST_LAG >> 2;
+#endif
+  budget -= (int16_t)dvR + (V_C >> 2);
+  budget -= suspend_guard.margin / 4;
+  budget -= restore_guard.margin / 4;
+
+  // Binary search for the largest dirty set whose suspend fits the budget
+  unsigned lo = 0, hi = MAX_DIRTY_PAGES;
+  while (lo < hi) {
+    unsigned mid = (lo + hi + 1) / 2;
+    uint16_t dvS = vdrop_lsb(untracked_bytes() + mid * PAGE_SIZE);
+    if (dvS != UINT16_MAX && (int16_t)dvS <= budget) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
+#else
+  return MAX_DIRTY_PAGES;
+#endif
+}
+
+/**
+ * Bytes that are always saved and restored: .data, .bss and the stack.
+ */
+static unsigned untracked_bytes(void) {
+  static unsigned untracked = 0;
+  if (untracked == 0) { // Hack to calculate this once. Ideally should be a
+                        // const calculated by the compiler/preprocessor
+    untracked =
+        (unsigned)((&__data_high - &__data_low) + (&__bss_high - &__bss_low) +
+                   (&__stack_high - &__stack_low));
+  }
+  return untracked;
+}
+
+/**
+ * Voltage drop of saving/restoring nbytes, from the calibrated model if
+ * available, else the generated vdrop table.
+ * @return drop in ADC LSBs, or UINT16_MAX if nbytes is beyond the table
+ */
+static uint16_t vdrop_lsb(unsigned nbytes) {
+  if (dvdb_model.valid == DVDB_MODEL_VALID) {
+    return calculate_dvdb(nbytes) >> 2;
+  }
+  if ((nbytes >> VDROP_SHIFT) >= VDROP_LEN) {
+    return UINT16_MAX;
+  }
+  return vdrop[nbytes >> VDROP_SHIFT];
 }
 
 uint16_t calculate_dvdb(size_t nbytes) {
+  if (dvdb_model.valid == DVDB_MODEL_VALID) {
+    int32_t dv = ((dvdb_model.dvdt * (uint32_t)nbytes) >> 10) +
+                 (int32_t)dvdb_model.offset;
+    return dv > 0 ? (uint16_t)dv : 0;
+  }
   return (uint16_t)((DVDT * (uint32_t)nbytes) >> 10);
 }
 
-void comparator_init() {
-  // Set up 3.0 as comparator input C12
-  // Should be tied to vcc/2 externally
-  // P3SEL1 = BIT0;
-  // P3SEL2 = BIT0;
+/**
+ * Sample supply voltage from the running window-comparator conversion.
+ * @return Vcc in ADC LSBs (same units as ADC12HI/ADC12LO)
+ */
+static uint16_t sample_vcc(void) {
+  uint16_t sum = 0;
+  for (int i = 0; i < 4; i++) {
+    ADC12IFGR0 &= ~ADC12IFG0;
+    while (!(ADC12IFGR0 & ADC12IFG0))
+      ; // Wait for next conversion
+    sum += ADC12MEM0;
+  }
+  return sum >> 2;
+}
 
-  // Set up voltage reference
-  // Configure internal reference
-  // while (REFCTL0 & REFGENBUSY)
-  //;
-  // REFCTL0 |= REFVSEL_0 | REFON; // Select internal ref = 1.2 V
-  // while (!(REFCTL0 & REFGENRDY))
-  //;
-  //
-  // Set up reference voltage generator (resistor ladder)
-  // CEREFLx = 0;
-  // CEON = 1;
-  // CERS = 0b01;
-  // CEREF0 = 0b01000;
-  // CEMRVS = 1;
-  // CEMRVL = 0;
-  // CECTL1 = CEMRVS_1 | CEMRVL_0 | CEON | CEPWRMD_2 | DEFDLY_1 | CEEX_0 |
-  // CESHORT_0 | CEIES_1 | CEF_1 | CEOUTPOL_0;
-  // uint8_t ladder_select = 0b01000;
-  // CECTL2 = CEREFL_1 | CERS_1 | CERSEL_1 | ladder_select;
-  //
-  //// Set up comparator
-  // CEPWRMD
-  // CEIMSEL = CESHORT = 0 CEEX = 0 CERSEL = 0 CEON = 1 CEF = 0 CEOUTPOL =
-  // 0 CEIFG = NEGEDGE;
-  //
-  // CEINT = CEIE;
+bool ic_calibrate(void) {
+  extern uint8_t __data_low;
+  int32_t x[CAL_STEPS]; // Bytes transferred
+  int32_t y[CAL_STEPS]; // Voltage drop [1024 x V]
+  int32_t sx = 0, sy = 0;
+  int32_t drop = 0; // Drop of the transfers so far [ADC LSBs]
+  uint32_t cycles = 0;
+  int n = 0;
+
+  bool gie = get_interrupt_enable();
+  __disable_interrupt(); // Keep suspend out of the measurement
+
+#ifdef COMP_MONITOR
+  adc_init(); // ADC is only on for the duration of the calibration, fast
+  ADC12IER2 = 0;
+#else
+  // Sample at full rate, so that sample_vcc() costs as little as possible
+  const bool watch_low = adc_watch_low, fast = adc_fast;
+  adc_watch_low = true;
+  adc_fast = true;
+  adc_program();
+  ADC12IER2 = 0;
+#endif
+  dfs_set(DFS_HIGH); // Same clock as suspend
+
+  uint16_t v = sample_vcc();
+  for (n = 0; n < CAL_STEPS; n++) {
+    cycle_counter_start();
+    for (int r = 0; r < CAL_REPEAT; r++) {
+      // Any SRAM will do as source, only the FRAM writes matter
+      fastmemcpy(calibration_buffer, &__data_low, CAL_CHUNK);
+    }
+    cycles += cycle_counter_read();
+
+    // The drop over a step includes sampling it. An idle step, sampling
+    // only, measures that part, which would otherwise end up in the slope.
+    const uint16_t v_step = sample_vcc();
+    const uint16_t v_idle = sample_vcc();
+    drop += ((int32_t)v - v_step) - ((int32_t)v_step - v_idle);
+    v = v_idle;
+
+    x[n] = (int32_t)(n + 1) * CAL_CHUNK * CAL_REPEAT;
+    y[n] = drop << 2;
+    sx += x[n];
+    sy += y[n];
+    if (v <= ((VON + V_C) >> 2)) {
+      n++;
+      break; // Stop before running out of energy
+    }
+  }
+
+#ifdef COMP_MONITOR
+  ADC12CTL0 &= ~ADC12ENC; // Stop conversion
+  ADC12CTL0 &= ~ADC12ON;  // Turn off
+  ADC12IFGR2 = 0;
+#else
+  adc_watch_low = watch_low;
+  adc_fast = fast;
+  adc_program();
+  ADC12IFGR2 = 0;
+#endif
+  dfs_set(dfs_running_level());
+
+  if (gie) {
+    __enable_interrupt();
+  }
+
+  if (n < 2) {
+    return false;
+  }
+
+  // Least-squares fit of y = slope * x + offset
+  int64_t sxx = 0, sxy = 0;
+  for (int i = 0; i < n; i++) {
+    const int32_t dx = n * x[i] - sx;
+    sxx += (int64_t)dx * dx;
+    sxy += (int64_t)dx * (n * y[i] - sy);
+  }
+  if (sxx == 0 || sxy <= 0) {
+    return false; // No voltage drop, supply probably still connected
+  }
+  const int32_t dvdt = (int32_t)((sxy << 10) / sxx);
+  const int32_t offset = (sy - (int32_t)(((int64_t)dvdt * sx) >> 10)) / n;
+
+  if (dvdt <= 0 || dvdt > UINT16_MAX) {
+    return false;
+  }
+
+  dvdb_model.valid = 0;
+  dvdb_model.dvdt = (uint16_t)dvdt;
+  dvdb_model.offset = (int16_t)offset;
+  dvdb_model.cycles_per_kb = (uint16_t)((cycles << 10) / x[n - 1]);
+  dvdb_model.valid = DVDB_MODEL_VALID;
+  return true;
+}
+
+#ifdef COMP_MONITOR
+/**
+ * Ladder tap for a Vcc threshold. The comparator trips when
+ * Vcc / COMP_VCC_DIV = 2.0 V * (tap + 1) / 32.
+ * @param lsb threshold in ADC LSBs (Vcc/256 V)
+ * @return tap, rounded up to the next safe level
+ */
+static uint16_t comp_tap(uint16_t lsb) {
+  uint16_t tap = (lsb + COMP_LSB_PER_TAP - 1) / COMP_LSB_PER_TAP;
+  if (tap > 32) {
+    tap = 32;
+  }
+  return tap > 0 ? tap - 1 : 0;
+}
+
+/**
+ * Emulate the level-triggered ADC window: raise the flag of the watched side
+ * if the supply is already beyond it, since COMP_E only flags edges.
+ */
+static void comp_sync(void) {
+  __delay_cycles(COMP_SETTLE_CYCLES); // Ladder & output filter settling
+  uint16_t flags = 0;
+  if (CECTL1 & CEMRVL) { // Watching low threshold
+    if (!(CECTL1 & CEOUT)) {
+      flags = CEIIFG;
+    }
+  } else if (CECTL1 & CEOUT) { // Watching high threshold
+    flags = CEIFG;
+  }
+  CEINT = (CEINT & ~(CEIFG | CEIIFG)) | flags;
+}
+
+/**
+ * Set up COMP_E to monitor supply voltage. Vcc must be divided by COMP_VCC_DIV
+ * externally onto C12 (P3.0), and is compared against the shared 2.0 V
+ * reference through the resistor ladder. Unlike the ADC, nothing is sampled
+ * continuously.
+ */
+static void comparator_init(void) {
+  // P3.0 as comparator input C12
+  P3DIR &= ~BIT0;
+  P3SEL0 |= BIT0;
+  P3SEL1 |= BIT0;
+
+  CECTL1 &= ~CEON; // Turn off while configuring
+
+  CECTL0 = CEIPEN | CEIPSEL_12; // Vcc/COMP_VCC_DIV on V+
+
+  CECTL2 = CEREFL_2 | // Request 2.0 V from the shared reference
+           CERS_2 |   // Shared reference applied to ladder
+           CERSEL;    // Ladder output on V-
+#ifdef MANAGEDSTATE
+  monitor_set_thresholds(restore_thr, presuspend_thr);
+#else
+  monitor_set_thresholds(restore_thr, suspend_thr);
+#endif
+
+  CECTL3 = CEPD12; // Disable input buffer on C12
+
+  CECTL1 = CEPWRMD_1 | // Normal power mode, a few us response time
+           CEF |       // Output filter
+           CEFDLY_3 |  // Max filter delay
+           CEMRVS |    // Select ladder tap in software (CEMRVL)
+           CEON;       // Turn on
+
+  // Wait for restore threshold
+  CEINT = CEIE;
+  comp_sync();
+}
+#endif
+
+static void monitor_init(void) {
+#ifdef COMP_MONITOR
+  comparator_init();
+#else
+  adc_init();
+#endif
+}
+
+static void monitor_set_thresholds(uint16_t high, uint16_t low) {
+#ifdef COMP_MONITOR
+  uint16_t tap = comp_tap(high);
+  if ((tap + 1) * COMP_LSB_PER_TAP > (VMAX >> 2) && tap > 0) {
+    tap--; // Rounded up past VMAX, would never be reached
+  }
+  CECTL2 = (CECTL2 & ~CEREF0_31) | tap; // CEREF0 = restore threshold
+  monitor_set_low(low);
+#else
+  adc_high = high;
+  adc_low = low;
+  adc_program();
+#endif
+}
+
+static void monitor_set_low(uint16_t low) {
+#ifdef COMP_MONITOR
+  uint16_t tap = comp_tap(low);
+  const uint16_t tap_high = CECTL2 & CEREF0_31;
+  if (tap >= tap_high && tap_high > 0) {
+    tap = tap_high - 1; // Keep at least one tap of hysteresis
+  }
+  CECTL2 = (CECTL2 & ~CEREF1_31) | (tap << 8); // CEREF1 = low threshold
+  comp_sync();
+#else
+  adc_low = low;
+  adc_program();
+#endif
+}
+
+static void monitor_watch_high(void) {
+#ifdef COMP_MONITOR
+  CECTL1 &= ~CEMRVL; // Compare against CEREF0
+  CEINT = (CEINT & ~CEIIE) | CEIE;
+  comp_sync();
+#else
+  adc_watch_low = false;
+  adc_program();
+#endif
+}
+
+static void monitor_watch_low(void) {
+#ifdef COMP_MONITOR
+  CECTL1 |= CEMRVL; // Compare against CEREF1
+  CEINT = (CEINT & ~CEIE) | CEIIE;
+  comp_sync();
+#else
+  adc_watch_low = true;
+  adc_program();
+#endif
+}
+
+static void monitor_clear_flags(void) {
+#ifdef COMP_MONITOR
+  comp_sync(); // Only keeps flags that are still valid
+#else
+  ADC12IFGR2 = 0;
+#endif
+}
+
+#ifdef DEEP_SLEEP
+static bool monitor_above_high(void) {
+#ifdef COMP_MONITOR
+  return !(CECTL1 & CEMRVL) && (CECTL1 & CEOUT);
+#else
+  // Runs on every RTC wake: wait for one conversion at full rate (~0.2 ms)
+  // rather than at the slow rate used while charging (~3 ms)
+  adc_watch_low = true;
+  adc_fast = true;
+  adc_program();
+  ADC12IER2 = 0;
+  ADC12IFGR0 &= ~ADC12IFG0;
+  while (!(ADC12IFGR0 & ADC12IFG0))
+    ; // Wait for a conversion
+  const bool above = ADC12MEM0 >= adc_high;
+
+  adc_watch_low = false; // Back to waiting for the restore threshold
+  adc_fast = false;
+  adc_program();
+  ADC12IFGR2 = 0;
+  return above;
+#endif
+}
+#endif
+
+static bool monitor_below_low(void) {
+#ifdef COMP_MONITOR
+  return (CECTL1 & CEMRVL) && !(CECTL1 & CEOUT);
+#else
+  if (!(ADC12IFGR2 & ADC12LOIFG)) {
+    return false;
+  }
+  if (!adc_fast) { // Entered band above threshold, polled (e.g. in restore())
+    adc_set_fast(true);
+    return false;
+  }
+  return true;
+#endif
+}
+
+/**
+ * Supply voltage left above a threshold, used by the guard band controller.
+ * COMP_E can only tell whether the supply is at least one ladder tap above it.
+ * @param limit threshold in ADC LSBs
+ * @return headroom [1024 x V]
+ */
+static int16_t monitor_headroom(uint16_t limit) {
+#ifdef COMP_MONITOR
+  const uint16_t ctl1 = CECTL1, ctl2 = CECTL2;
+  uint16_t probe = comp_tap(limit) + 1;
+  if (probe > 31) {
+    probe = 31;
+  }
+  CECTL2 = (ctl2 & ~CEREF1_31) | (probe << 8);
+  CECTL1 |= CEMRVL;
+  __delay_cycles(COMP_SETTLE_CYCLES);
+  const bool above = CECTL1 & CEOUT;
+  CECTL2 = ctl2;
+  CECTL1 = ctl1;
+  comp_sync();
+  return above ? (COMP_LSB_PER_TAP << 2) : 0;
+#else
+  return ((int16_t)ADC12MEM0 - limit) << 2;
+#endif
+}
+
+static monitor_event_t monitor_event(void) {
+#ifdef COMP_MONITOR
+  switch (__even_in_range(CEIV, CEIV_CEIIFG)) {
+  case CEIV_CEIFG: // Rising edge
+    return MONITOR_HIGH;
+  case CEIV_CEIIFG: // Falling edge
+    return MONITOR_LOW;
+  default:
+    return MONITOR_NONE;
+  }
+#else
+  switch (__even_in_range(ADC12IV, ADC12IV__ADC12RDYIFG)) {
+  case ADC12IV__ADC12HIIFG:
+    if (adc_watch_low) { // Recovered out of the band, slow down
+      adc_set_fast(false);
+      return MONITOR_NONE;
+    }
+    return MONITOR_HIGH;
+  case ADC12IV__ADC12LOIFG:
+    if (!adc_fast) { // Entered band above threshold, speed up
+      adc_set_fast(true);
+      return MONITOR_NONE;
+    }
+    return MONITOR_LOW;
+  default:
+    return MONITOR_NONE;
+  }
+#endif
 }
 
 void __attribute__((no_instrument_function))
@@ -9,6 +9,9 @@
 
 #include "lib/iclib/config.h"
 
+// ic_timer_read() wraps: TA1 counts SMCLK / 8 (16 bits)
+#define IC_TIMER_MASK 0x7FFFFul
+
 /**
  * @brief fastmemcpy Hand-crafted faster version of memcpy for msp430. The
  * default implementation is very inefficient.
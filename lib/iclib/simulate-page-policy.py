@@ -0,0 +1,513 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019-2020, University of Southampton and Contributors.
+# All rights reserved.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+
+"""
+Replay an acquire trace through a model of the ManagedState memory manager,
+for a grid of PAGE_SIZE and MAX_DIRTY_PAGES and for several write-back
+policies, and recommend the configuration that moves the fewest bytes to and
+from NVM.
+
+The trace is recorded by the host target with ICLIB_MM_TRACE=<file> (see
+generate-mmdata-layout.py for the format). The model follows
+memory-management.c: an acquire loads its pages, and writing to a clean page
+first writes back inactive dirty pages while the dirty set is at its limit.
+The limit is the smaller of MAX_DIRTY_PAGES and the pages that keep the
+restore threshold below VMAX (ic_max_dirty_pages()). mm_flush() and the
+suspend of a power failure write back every dirty page. After the restore,
+only the active pages are loaded.
+
+Write-back policies, i.e. which inactive dirty page to write back:
+  lru      least recently acquired for writing (memory-management.c)
+  clock    second chance, any acquire sets the reference bit
+  arc      adaptive replacement between pages written once and more often
+  belady   the page written again furthest in the future (optimal)
+
+Columns of the report (--csv):
+  loaded, written     bytes loaded by acquires, written back to keep the
+                      dirty set within its limit or by mm_flush()
+  suspended, restored bytes of managed pages saved and restored on failures
+  total               all of the above
+  v_suspend, v_restore  highest suspend and restore thresholds [V]
+  status              ok, or hang where memory-management.c would stop with
+                      the LRU table full of active dirty pages
+
+The recommendation, as <PAGE_SIZE>x<MAX_DIRTY_PAGES>, is written to the
+output file, e.g. <app>.mmconfig in ICLIB_PROFILE_DIR, which links the app
+against an iclib built with these settings (see cmake/tail.cmake).
+
+Usage:
+  simulate-page-policy.py --config config.h --nm nm --elf app.elf \\
+      --trace app.mmtrace -o app.mmconfig
+  simulate-page-policy.py ... --page-sizes 64 128 --max-dirty 8 16 \\
+      --fail-every 200 --csv grid.csv
+"""
+
+import argparse
+import bisect
+import collections
+import csv
+import importlib.util
+import os
+import subprocess
+import sys
+
+POLICIES = ['lru', 'clock', 'arc', 'belady']
+FIELDS = ['policy', 'page_size', 'max_dirty', 'status', 'loaded', 'written',
+          'suspended', 'restored', 'total', 'failures', 'v_suspend',
+          'v_restore']
+DUMMY_PAGE = 255  # Page numbers must stay below, see memory-management.c
+
+Event = collections.namedtuple('Event', 'kind addr len write')
+
+
+def load_dvdb_module():
+    """parse_config() and Model of generate-dvdb-table.py, next to this."""
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        'generate-dvdb-table.py')
+    spec = importlib.util.spec_from_file_location('dvdb', path)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+def read_symbols(args):
+    output = subprocess.check_output([args.nm, args.elf]).decode()
+    symbols = {}
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) == 3:
+            symbols[fields[2]] = int(fields[0], 16)
+    for name in ('__mmdata_low', '__mmdata_high'):
+        if name not in symbols:
+            sys.exit('error: {} has no {}'.format(args.elf, name))
+    return symbols
+
+
+def read_trace(path, low, high):
+    """Events within .mmdata, as offsets from its start."""
+    events = []
+    for line in open(path):
+        fields = line.split('#')[0].split()
+        if not fields:
+            continue
+        kind = fields[0]
+        if kind in ('W', 'P'):
+            events.append(Event(kind, 0, 0, False))
+        elif kind in ('A', 'R', 'D') and len(fields) >= 3:
+            addr = int(fields[1], 16)
+            if low <= addr < high:  # Else not managed, e.g. FRAM_DIRECT
+                write = len(fields) > 3 and fields[3] == 'rw'
+                events.append(Event(kind, addr - low, max(int(fields[2]), 1),
+                                    write))
+    return events
+
+
+def with_failures(events, every):
+    """Add a power failure after every `every` acquires."""
+    if not every:
+        return events
+    result, acquires = [], 0
+    for event in events:
+        result.append(event)
+        if event.kind == 'A':
+            acquires += 1
+            if acquires % every == 0:
+                result.append(Event('P', 0, 0, False))
+    return result
+
+
+class Lru:
+    """Order of acquires for writing, as the LRU table of iclib."""
+
+    def __init__(self, sim):
+        self.sim = sim
+        self.order = collections.OrderedDict()  # Oldest first
+
+    def reset(self):
+        self.order.clear()
+
+    def acquired(self, page, write):
+        if write:
+            self.order[page] = True
+            self.order.move_to_end(page)
+
+    def removed(self, page):
+        self.order.pop(page, None)
+
+    def victim(self):
+        for page in self.order:
+            if self.sim.inactive_dirty(page):
+                del self.order[page]
+                return page
+        return None
+
+
+class Clock:
+    def __init__(self, sim):
+        self.sim = sim
+        self.reset()
+
+    def reset(self):
+        self.ring, self.referenced, self.hand = [], set(), 0
+
+    def acquired(self, page, write):
+        if page in self.sim.dirty and page not in self.ring:
+            self.ring.append(page)
+        self.referenced.add(page)
+
+    def removed(self, page):
+        if page in self.ring:
+            i = self.ring.index(page)
+            self.ring.pop(i)
+            if i < self.hand:
+                self.hand -= 1
+        self.referenced.discard(page)
+
+    def victim(self):
+        for _ in range(2 * len(self.ring) + 1):
+            if not self.ring:
+                break
+            self.hand %= len(self.ring)
+            page = self.ring[self.hand]
+            if not self.sim.inactive_dirty(page):
+                self.hand += 1
+            elif page in self.referenced:
+                self.referenced.discard(page)
+                self.hand += 1
+            else:
+                self.removed(page)
+                return page
+        return None
+
+
+class Arc:
+    """Dirty pages written once (t1) or more often (t2) since they became
+    dirty, with ghosts of pages written back from each (b1, b2)."""
+
+    def __init__(self, sim):
+        self.sim = sim
+        self.c = sim.max_dirty
+        self.reset()
+
+    def reset(self):
+        self.t1, self.t2 = collections.OrderedDict(), collections.OrderedDict()
+        self.b1, self.b2 = collections.OrderedDict(), collections.OrderedDict()
+        self.p = 0.0
+
+    def acquired(self, page, write):
+        if not write:
+            return
+        if page in self.t1:
+            del self.t1[page]
+            self.t2[page] = True
+        elif page in self.t2:
+            self.t2.move_to_end(page)
+        elif page in self.b1:  # Written back too early from t1
+            self.p = min(self.c, self.p + max(1, len(self.b2) / len(self.b1)))
+            del self.b1[page]
+            self.t2[page] = True
+        elif page in self.b2:
+            self.p = max(0, self.p - max(1, len(self.b1) / len(self.b2)))
+            del self.b2[page]
+            self.t2[page] = True
+        else:
+            self.t1[page] = True
+
+    def removed(self, page):
+        self.t1.pop(page, None)
+        self.t2.pop(page, None)
+
+    def victim(self):
+        lists = [(self.t1, self.b1), (self.t2, self.b2)]
+        if len(self.t1) <= self.p:
+            lists.reverse()
+        for t, b in lists:
+            for page in t:
+                if self.sim.inactive_dirty(page):
+                    del t[page]
+                    b[page] = True
+                    if len(b) > self.c:
+                        b.popitem(last=False)
+                    return page
+        return None
+
+
+class Belady:
+    """Write back the page whose next acquire for writing is furthest away."""
+
+    def __init__(self, sim):
+        self.sim = sim
+        self.writes = collections.defaultdict(list)  # Page: event indices
+        for i, event in enumerate(sim.events):
+            if event.kind == 'A' and event.write:
+                for page in sim.pages(event):
+                    self.writes[page].append(i)
+
+    def reset(self):
+        pass
+
+    def acquired(self, page, write):
+        pass
+
+    def removed(self, page):
+        pass
+
+    def next_write(self, page):
+        times = self.writes[page]
+        i = bisect.bisect_right(times, self.sim.now)
+        return times[i] if i < len(times) else float('inf')
+
+    def victim(self):
+        candidates = [p for p in self.sim.dirty if self.sim.inactive_dirty(p)]
+        if not candidates:
+            return None
+        return max(candidates, key=lambda p: (self.next_write(p), -p))
+
+
+class Simulation:
+    def __init__(self, events, mmdata_size, page_size, max_dirty, policy,
+                 model, cfg, untracked):
+        self.events = events
+        self.mmdata_size = mmdata_size
+        self.page_size = page_size
+        self.max_dirty = max_dirty
+        self.model = model
+        self.cfg = cfg
+        self.untracked = untracked
+        self.loaded, self.dirty = set(), set()
+        self.refcnt = collections.Counter()
+        self.now = 0
+        self.bytes = collections.Counter()
+        self.failures = 0
+        self.v_suspend = self.v_restore = 0.0
+        self.policy = {'lru': Lru, 'clock': Clock, 'arc': Arc,
+                       'belady': Belady}[policy](self)
+
+    def pages(self, event):
+        first = event.addr // self.page_size
+        last = (event.addr + event.len - 1) // self.page_size
+        if event.kind == 'D':  # Only pages entirely within the array
+            first = (event.addr + self.page_size - 1) // self.page_size
+            last = (event.addr + event.len) // self.page_size - 1
+        return range(first, last + 1)
+
+    def page_bytes(self, page):
+        return min(self.page_size, self.mmdata_size - page * self.page_size)
+
+    def inactive_dirty(self, page):
+        return page in self.dirty and self.refcnt[page] == 0
+
+    def volts(self, lsb):
+        return lsb / 1024  # Units of config.h
+
+    def thresholds(self):
+        """Suspend and restore thresholds [V], as ic_update_thresholds()."""
+        suspend = self.volts(self.cfg['VON'] + self.cfg['ADC_FAST_LAG']) + \
+            self.model.vdrop(self.untracked + len(self.dirty) * self.page_size)
+        active = sum(1 for p in self.refcnt if self.refcnt[p] > 0)
+        restore = suspend + self.volts(self.cfg['V_C']) + self.model.vdrop(
+            self.untracked + active * self.page_size)
+        return suspend, min(restore, self.volts(self.cfg['VMAX']))
+
+    def dirty_budget(self, n_active):
+        """Dirty pages that fit between the thresholds and VMAX, as
+        ic_max_dirty_pages()."""
+        budget = (self.volts(self.cfg['VMAX']) - self.volts(self.cfg['VON']) -
+                  self.volts(self.cfg['ADC_FAST_LAG']) -
+                  self.volts(self.cfg['V_C']) -
+                  self.model.vdrop(self.untracked +
+                                   n_active * self.page_size) -
+                  self.model.vdrop(self.untracked))
+        if budget < 0:
+            return 0
+        return min(self.max_dirty,
+                   int(budget / self.model.vdrop(self.page_size)))
+
+    def write_back(self, page, kind):
+        self.bytes[kind] += self.page_bytes(page)
+        if self.refcnt[page] == 0:  # Active pages stay dirty
+            self.dirty.discard(page)
+            self.policy.removed(page)
+
+    def acquire(self, event):
+        for page in self.pages(event):
+            if event.write and page not in self.dirty:
+                n_active = sum(1 for p in self.refcnt if self.refcnt[p] > 0)
+                n_active += self.refcnt[page] == 0
+                budget = self.dirty_budget(n_active)
+                while len(self.dirty) >= budget:
+                    victim = self.policy.victim()
+                    if victim is None:
+                        break
+                    self.bytes['written'] += self.page_bytes(victim)
+                    self.dirty.discard(victim)
+                if len(self.dirty) >= self.max_dirty:
+                    return False
+                self.dirty.add(page)
+            if page not in self.loaded:
+                self.bytes['loaded'] += self.page_bytes(page)
+                self.loaded.add(page)
+            self.refcnt[page] += 1
+            self.policy.acquired(page, event.write)
+        return True
+
+    def release(self, event):
+        for page in self.pages(event):
+            if self.refcnt[page] > 0:
+                self.refcnt[page] -= 1
+
+    def fail(self):
+        """Suspend (write back dirty pages), lose SRAM, restore active pages"""
+        self.failures += 1
+        for page in sorted(self.dirty):
+            self.write_back(page, 'suspended')
+        self.loaded = {p for p in self.refcnt if self.refcnt[p] > 0}
+        self.bytes['restored'] += sum(self.page_bytes(p) for p in self.loaded)
+        self.policy.reset()  # mm_init_lru()
+        for page in self.dirty:  # Active dirty pages
+            self.policy.acquired(page, True)
+
+    def run(self):
+        status = 'ok'
+        for self.now, event in enumerate(self.events):
+            if event.kind == 'A':
+                if not self.acquire(event):
+                    status = 'hang'
+                    break
+            elif event.kind == 'R':
+                self.release(event)
+            elif event.kind == 'D':
+                for page in self.pages(event):
+                    if page in self.dirty and self.refcnt[page] == 0:
+                        self.dirty.discard(page)
+                        self.policy.removed(page)
+            elif event.kind == 'W':
+                for page in sorted(self.dirty):
+                    self.write_back(page, 'written')
+            elif event.kind == 'P':
+                self.fail()
+            v_suspend, v_restore = self.thresholds()
+            self.v_suspend = max(self.v_suspend, v_suspend)
+            self.v_restore = max(self.v_restore, v_restore)
+
+        row = dict(self.bytes)
+        for key in ('loaded', 'written', 'suspended', 'restored'):
+            row.setdefault(key, 0)
+        row.update(status=status, failures=self.failures,
+                   total=sum(self.bytes.values()),
+                   v_suspend=round(self.v_suspend, 3),
+                   v_restore=round(self.v_restore, 3))
+        return row
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+            formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--config', required=True, help='path to config.h')
+    parser.add_argument('--nm', required=True, help='toolchain `nm` program')
+    parser.add_argument('--elf', required=True, help='traced executable')
+    parser.add_argument('--trace', required=True, help='acquire trace')
+    parser.add_argument('--page-sizes', type=int, nargs='+',
+                        default=[32, 64, 128, 256, 512])
+    parser.add_argument('--max-dirty', type=int, nargs='+',
+                        default=[4, 8, 12, 16, 20, 32])
+    parser.add_argument('--policies', nargs='+', choices=POLICIES,
+                        default=POLICIES)
+    parser.add_argument('--policy', choices=POLICIES, default='lru',
+                        help='policy of the recommendation (iclib: lru)')
+    parser.add_argument('--fail-every', type=int, default=0,
+                        help='add a power failure after every N acquires, '
+                        'besides those of the trace')
+    parser.add_argument('--dvdb', type=float,
+                        help='voltage drop per byte [V] instead of DVDT')
+    parser.add_argument('--comp-monitor', action='store_true',
+                        help='supply monitored by COMP_E (no ADC lag)')
+    parser.add_argument('--csv', help='report of the whole grid')
+    parser.add_argument('-o', '--output', help='recommendation to write')
+    args = parser.parse_args()
+    if args.policy not in args.policies:
+        args.policies.append(args.policy)
+
+    dvdb = load_dvdb_module()
+    cfg = dvdb.parse_config(args.config, 'MS')
+    if args.comp_monitor:
+        cfg['ADC_FAST_LAG'] = 0  # Only the ADC monitor raises the suspend
+    model = dvdb.Model(argparse.Namespace(dvdb=args.dvdb, capacitance=None,
+                                          energy_per_byte=None), cfg)
+
+    symbols = read_symbols(args)
+    low, high = symbols['__mmdata_low'], symbols['__mmdata_high']
+    # Always saved and restored: .data, .bss and the stack, as budgeted
+    untracked = cfg['STACK_SIZE']
+    for section in ('data', 'bss'):
+        untracked += symbols.get('__{}_high'.format(section), 0) - \
+            symbols.get('__{}_low'.format(section), 0)
+
+    events = with_failures(read_trace(args.trace, low, high), args.fail_every)
+    if not any(e.kind == 'A' for e in events):
+        sys.exit('error: no acquires of .mmdata in {}'.format(args.trace))
+
+    rows = []
+    for page_size in args.page_sizes:
+        if cfg['MMDATA_SIZE'] // page_size >= DUMMY_PAGE:
+            print('PAGE_SIZE {}: too many pages for MMDATA_SIZE'.format(
+                page_size))
+            continue
+        for max_dirty in args.max_dirty:
+            if max_dirty >= DUMMY_PAGE:
+                continue
+            for policy in args.policies:
+                sim = Simulation(events, high - low, page_size, max_dirty,
+                                 policy, model, cfg, untracked)
+                row = sim.run()
+                row.update(policy=policy, page_size=page_size,
+                           max_dirty=max_dirty)
+                rows.append(row)
+
+    if args.csv:
+        with open(args.csv, 'w', newline='') as out:
+            writer = csv.DictWriter(out, fieldnames=FIELDS,
+                                    extrasaction='ignore')
+            writer.writeheader()
+            writer.writerows(rows)
+
+    # Fewest bytes, then lowest thresholds, then the smallest LRU table
+    def rank(row):
+        return (row['total'], row['v_restore'], row['max_dirty'])
+
+    name = os.path.basename(args.elf)
+    for policy in args.policies:
+        ok = [r for r in rows if r['policy'] == policy and r['status'] == 'ok']
+        if ok:
+            best = min(ok, key=rank)
+            print('{}: {:6} best {}x{:<3} {:9} bytes, {} failures, restore '
+                  '{:.2f} V'.format(name, policy, best['page_size'],
+                                    best['max_dirty'], best['total'],
+                                    best['failures'], best['v_restore']))
+
+    ok = [r for r in rows if r['policy'] == args.policy and
+          r['status'] == 'ok']
+    if not ok:
+        sys.exit('error: no configuration completes the trace')
+    best = min(ok, key=rank)
+    default = [r for r in ok if r['page_size'] == cfg['PAGE_SIZE'] and
+               r['max_dirty'] == cfg['MAX_DIRTY_PAGES']]
+    if default:
+        print('{}: config.h {}x{} {} bytes'.format(
+            name, cfg['PAGE_SIZE'], cfg['MAX_DIRTY_PAGES'],
+            default[0]['total']))
+    if args.output:
+        with open(args.output, 'w') as out:
+            out.write('# Generated by simulate-page-policy.py from {}: {}, '
+                      '{} bytes\n'.format(os.path.basename(args.trace),
+                                          args.policy, best['total']))
+            out.write('{}x{}\n'.format(best['page_size'], best['max_dirty']))
+
+
+if __name__ == '__main__':
+    main()
@@ -5,7 +5,9 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
+#include "lib/cmsis/core_cm0.h"
 #include "lib/support/cm0-support.h"
+#include "lib/support/support.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
@@ -36,6 +38,28 @@ void indicate_workload_end() {
   Gpio->DATA.WORD &= ~PIN_WORKLOAD_BEGIN;
 }
 
+#if defined(SIMULATION) &&                                                     \
+    (MONITOR_RESERVED(SIMPLE_MONITOR_INDICATE_BEGIN) ||                        \
+     MONITOR_RESERVED(SIMPLE_MONITOR_INDICATE_END) ||                          \
+     MONITOR_RESERVED(SIMPLE_MONITOR_TEST_FAIL) ||                             \
+     MONITOR_RESERVED(SIMPLE_MONITOR_KILL_SIM) ||                              \
+     MONITOR_RESERVED(SIMPLE_MONITOR_SW_ERROR))
+#error A SIMPLE_MONITOR code clashes with the codes reserved for phase events
+#endif
+
+void indicate_phase(monitor_phase_t event, uint32_t payload) {
+#ifdef SIMULATION
+  // The suspend may interrupt an event: keep the four words together
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  SIMPLE_MONITOR = MONITOR_PHASE;
+  SIMPLE_MONITOR = event;
+  SIMPLE_MONITOR = payload & 0xFFFF;
+  SIMPLE_MONITOR = payload >> 16;
+  __set_PRIMASK(primask);
+#endif
+}
+
 void indicate_test_fail() {
 #ifdef SIMULATION
   SIMPLE_MONITOR = SIMPLE_MONITOR_TEST_FAIL;
@@ -77,3 +101,20 @@ void target_init() {
 void assert_keep_alive() { Gpio->DATA.WORD |= PIN_KEEP_ALIVE; }
 
 void deassert_keep_alive() { Gpio->DATA.WORD &= ~PIN_KEEP_ALIVE; }
+
+// SysTick counts down from 2^24 - 1 at the core clock. Once started it keeps
+// running, iclib also reads it to time its phases (IC_TIMING).
+static uint32_t cycle_counter_base;
+
+void cycle_counter_start() {
+  if (!(SysTick->CTRL & SysTick_CTRL_ENABLE_Msk)) {
+    SysTick->LOAD = SysTick_LOAD_RELOAD_Msk;
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+  }
+  cycle_counter_base = SysTick->VAL;
+}
+
+uint32_t cycle_counter_read() {
+  return (cycle_counter_base - SysTick->VAL) & SysTick_LOAD_RELOAD_Msk;
+}
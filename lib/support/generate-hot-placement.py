@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019-2020, University of Southampton and Contributors.
+# All rights reserved.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+
+"""
+Profile-guided placement of hot functions and constant tables into SRAM.
+
+`profile` maps sampled addresses (PC samples for code, load addresses for
+tables, e.g. from a simulator or debugger trace) to symbols of the profiled
+executable. Each line of the samples file is `<hex address> [count]`.
+
+`place` greedily picks the symbols with the highest weight per byte that fit
+in the SRAM budget, and writes the linker script fragments included by
+msp430fr5994.ld: hot-text.ld (into .ramtext) and hot-rodata.ld (into
+.ramrodata). Both fragments are written, empty if there is nothing to place.
+
+Placement relies on -ffunction-sections -fdata-sections, so that each
+function/table has its own input section (.text.<name>, .rodata.<name>).
+
+Usage:
+  generate-hot-placement.py profile --nm msp430-elf-nm --elf app.elf \\
+      --samples app.samples -o app.profile
+  generate-hot-placement.py place --profile app.profile --budget 512 \\
+      -o build/app-hot
+"""
+
+import argparse
+import bisect
+import os
+import subprocess
+import sys
+
+# nm symbol types -> kind of input section to relocate
+KINDS = {'t': 'text', 'T': 'text', 'r': 'rodata', 'R': 'rodata'}
+
+FRAGMENTS = {'text': 'hot-text.ld', 'rodata': 'hot-rodata.ld'}
+
+
+def read_symbols(nm, elf):
+    """Sized text and rodata symbols of elf, sorted by address."""
+    output = subprocess.check_output([nm, '-S', '--defined-only', elf])
+    symbols = []
+    for line in output.decode().splitlines():
+        fields = line.split()
+        if len(fields) != 4 or fields[2] not in KINDS:
+            continue
+        addr, size = int(fields[0], 16), int(fields[1], 16)
+        if size:
+            symbols.append((addr, size, KINDS[fields[2]], fields[3]))
+    symbols.sort()
+    return symbols
+
+
+def read_samples(path):
+    samples = {}
+    for line in open(path):
+        fields = line.split('#')[0].split()
+        if not fields:
+            continue
+        addr = int(fields[0], 16)
+        count = int(fields[1]) if len(fields) > 1 else 1
+        samples[addr] = samples.get(addr, 0) + count
+    return samples
+
+
+def profile(args):
+    symbols = read_symbols(args.nm, args.elf)
+    starts = [s[0] for s in symbols]
+    weights = {}
+    unmapped = 0
+    for addr, count in read_samples(args.samples).items():
+        i = bisect.bisect_right(starts, addr) - 1
+        if i >= 0 and addr < symbols[i][0] + symbols[i][1]:
+            weights[i] = weights.get(i, 0) + count
+        else:
+            unmapped += count
+    with open(args.output, 'w') as out:
+        out.write('# kind symbol size weight\n')
+        for i, weight in sorted(weights.items(), key=lambda w: -w[1]):
+            _, size, kind, name = symbols[i]
+            out.write('{} {} {} {}\n'.format(kind, name, size, weight))
+    if unmapped:
+        print('{}: {} samples outside sized symbols'.format(
+            args.samples, unmapped))
+
+
+def place(args):
+    candidates = []
+    for line in open(args.profile):
+        fields = line.split('#')[0].split()
+        if len(fields) == 4 and fields[0] in FRAGMENTS:
+            candidates.append((fields[0], fields[1], int(fields[2]),
+                               int(fields[3])))
+
+    # Greedy knapsack by weight per byte, sizes rounded up to word alignment
+    candidates.sort(key=lambda c: -c[3] / c[2])
+    chosen = {kind: [] for kind in FRAGMENTS}
+    used = 0
+    for kind, name, size, weight in candidates:
+        size += size & 1
+        if weight > 0 and used + size <= args.budget:
+            chosen[kind].append(name)
+            used += size
+
+    os.makedirs(args.output, exist_ok=True)
+    for kind, fragment in FRAGMENTS.items():
+        with open(os.path.join(args.output, fragment), 'w') as out:
+            out.write('/* Generated by generate-hot-placement.py */\n')
+            for name in chosen[kind]:
+                out.write('*(.{}.{})\n'.format(kind, name))
+    print('{}: {} of {} SRAM bytes for hot code/tables'.format(
+        args.profile, used, args.budget))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+            formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('command', choices=['profile', 'place'])
+    parser.add_argument('--nm', help='toolchain `nm` program')
+    parser.add_argument('--elf', help='profiled executable')
+    parser.add_argument('--samples', help='sampled addresses')
+    parser.add_argument('--profile', help='profile written by `profile`')
+    parser.add_argument('--budget', type=int, default=512,
+                        help='SRAM bytes available for hot code/tables')
+    parser.add_argument('-o', '--output', required=True,
+                        help='profile to write, or fragment directory')
+    args = parser.parse_args()
+
+    if args.command == 'profile':
+        if not args.nm or not args.elf or not args.samples:
+            parser.error('profile needs --nm, --elf and --samples')
+        profile(args)
+    else:
+        if not args.profile:
+            parser.error('place needs --profile')
+        place(args)
+
+
+if __name__ == '__main__':
+    main()
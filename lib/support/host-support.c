@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2019-2020, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "lib/support/host-support.h"
+#include "lib/support/support.h"
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static struct timespec cycle_counter_t0;
+
+// Interrupt state, a register on a device: outside the simulated SRAM
+#define HOST_REGISTER __attribute__((section(".persistent")))
+static volatile sig_atomic_t irq_disabled HOST_REGISTER = 0;
+static volatile sig_atomic_t irq_pending HOST_REGISTER = 0;
+static bool monitor_enabled HOST_REGISTER = false; //! ICLIB_MONITOR is set
+
+__attribute__((constructor)) static void monitor_init(void) {
+  monitor_enabled = getenv("ICLIB_MONITOR") != NULL;
+}
+
+void host_monitor(const char *event) {
+  if (monitor_enabled) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    fprintf(stderr, "iclib-monitor: %s %lld\n", event,
+            t.tv_sec * 1000000000ll + t.tv_nsec);
+  }
+}
+
+void indicate_workload_begin() { host_monitor("INDICATE_BEGIN"); }
+
+void indicate_workload_end() { host_monitor("INDICATE_END"); }
+
+/**
+ * @brief Append a string, async-signal-safe unlike snprintf()
+ * @return end of the appended text
+ */
+static char *append_str(char *p, const char *s) {
+  while (*s) {
+    *p++ = *s++;
+  }
+  return p;
+}
+
+/**
+ * @brief Append a number in decimal, async-signal-safe unlike snprintf()
+ * @return end of the appended text
+ */
+static char *append_u64(char *p, uint64_t v) {
+  char digits[20];
+  int n = 0;
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (n) {
+    *p++ = digits[--n];
+  }
+  return p;
+}
+
+void indicate_phase(monitor_phase_t event, uint32_t payload) {
+  // In .rodata: power failures overwrite .data
+  static const char *const names[] = {
+      "BOOT_BEGIN",       "BOOT_END",
+      "RESTORE_BEGIN",    "RESTORE_END",
+      "SUSPEND_BEGIN",    "SUSPEND_END",
+      "FLUSH_BEGIN",      "FLUSH_END",
+      "THRESHOLDS_BEGIN", "THRESHOLDS_END",
+      "CHECKPOINT_BEGIN", "CHECKPOINT_END"};
+  if (monitor_enabled) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    // Suspends run in the power failure handler, which may have interrupted
+    // a print holding the lock of stderr: format by hand and write(2)
+    char line[80];
+    char *p = append_str(line, "iclib-monitor: ");
+    p = append_str(p, names[event - MONITOR_BOOT_BEGIN]);
+    p = append_str(p, " ");
+    p = append_u64(p, t.tv_sec * 1000000000ull + t.tv_nsec);
+    p = append_str(p, " ");
+    p = append_u64(p, payload);
+    p = append_str(p, "\n");
+    if (write(STDERR_FILENO, line, p - line) < 0) {
+      return;
+    }
+  }
+}
+
+void indicate_test_fail() {
+  host_monitor("TEST_FAIL");
+  fprintf(stderr, "test failed\n");
+  exit(EXIT_FAILURE);
+}
+
+void end_experiment() {
+  host_monitor("KILL_SIM");
+  exit(EXIT_SUCCESS);
+}
+
+void wait() {
+  // No delay: waiting would only add failures that do no work
+}
+
+// A flag instead of sigprocmask(), which costs a system call per critical
+// section (e.g. every mm_acquire())
+void disable_interrupt() {
+  irq_disabled = 1;
+  atomic_signal_fence(memory_order_seq_cst); // Keep the section after it
+}
+
+void enable_interrupt() {
+  atomic_signal_fence(memory_order_seq_cst); // Keep the section before it
+  irq_disabled = 0;
+  if (irq_pending) {
+    irq_pending = 0;
+    raise(HOST_FAIL_SIGNAL);
+  }
+}
+
+bool get_interrupt_enable() { return !irq_disabled; }
+
+bool host_interrupt_deferred(void) {
+  if (irq_disabled) {
+    irq_pending = 1;
+    return true;
+  }
+  return false;
+}
+
+void target_init() {}
+
+void assert_keep_alive() {}
+
+void deassert_keep_alive() {}
+
+// Nanoseconds instead of cycles
+void cycle_counter_start() {
+  clock_gettime(CLOCK_MONOTONIC, &cycle_counter_t0);
+}
+
+uint32_t cycle_counter_read() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint32_t)((t.tv_sec - cycle_counter_t0.tv_sec) * 1000000000ll +
+                    (t.tv_nsec - cycle_counter_t0.tv_nsec));
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2019-2020, University of Southampton and Contributors.
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Simulated supply warning (power failure), raised by the failure injector in
+// host-ic.c. While disable_interrupt() is in effect, its handler defers it.
+#define HOST_FAIL_SIGNAL SIGALRM
+
+/**
+ * @brief Stand-in for the Fused SIMPLE_MONITOR register. With ICLIB_MONITOR
+ * set, each event is printed to stderr as `iclib-monitor: <event> <time [ns]>`,
+ * where event is the name of the SIMPLE_MONITOR_* code without the prefix,
+ * e.g. INDICATE_BEGIN. Phase events (indicate_phase()) are followed by their
+ * payload, e.g. `iclib-monitor: SUSPEND_END <time [ns]> <bytes>`.
+ * @param event event name
+ */
+void host_monitor(const char *event);
+
+/**
+ * @brief Called first by the HOST_FAIL_SIGNAL handler. While interrupts are
+ * disabled, the signal is left pending and enable_interrupt() raises it again,
+ * as a masked interrupt is taken once it is unmasked on a device.
+ * @return true if the handler must return without handling the signal
+ */
+bool host_interrupt_deferred(void);
@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019-2020, University of Southampton and Contributors.
+# All rights reserved.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+
+"""
+Break down the time, and energy, of a run into the iclib phases (boot,
+restore, suspend, flush, thresholds, checkpoint), application compute and
+time without power, from the monitor events of a log.
+
+The log holds one line per monitor event, as printed by the host target with
+ICLIB_MONITOR set:
+  iclib-monitor: <event> <time> [<payload> [<energy>]]
+Phase events are <PHASE>_BEGIN and <PHASE>_END, written to SIMPLE_MONITOR as
+MONITOR_PHASE, the event code and the payload in two 16-bit halves, low first
+(monitor_phase_t in lib/support/support.h), other events (INDICATE_BEGIN, ...)
+only mark time. A simulator runner prints one line per event, decoding the
+three words after MONITOR_PHASE as a phase event, with the time in cycles
+and, to break down energy, the energy consumed so far [J].
+
+Nested phases (flush within suspend or checkpoint, thresholds within flush)
+are subtracted from the phase around them, so that the rows add up to the
+whole run. The time between the end of a suspend and the next event counts
+as off. Phases cut short by a power failure (a BOOT_BEGIN while they are in
+progress) are counted, their time counts as off.
+
+Usage:
+  ICLIB_MONITOR=1 ./build/apps/aes/aes-MS-host.elf 2> aes.log
+  monitor-phases.py aes.log
+  monitor-phases.py sim-*.log --csv phases.csv
+"""
+
+import argparse
+import collections
+import csv
+import re
+
+PHASES = ['BOOT', 'RESTORE', 'SUSPEND', 'FLUSH', 'THRESHOLDS', 'CHECKPOINT']
+ROWS = PHASES + ['COMPUTE', 'OFF']
+LINE = re.compile(r'^iclib-monitor: (\w+) (\d+)(?: (\d+))?(?: (\S+))?',
+                  re.MULTILINE)
+
+
+class Phase:
+    def __init__(self, name, time, energy):
+        self.name = name
+        self.time = time
+        self.energy = energy
+        self.child_time = 0
+        self.child_energy = 0
+
+
+def breakdown(log):
+    """Return the totals of each row and the span of the log"""
+    rows = collections.defaultdict(collections.Counter)
+    stack = []
+    last = None  # (time, energy) of the previous event
+    off = False
+    first = None
+    has_energy = False
+
+    for m in LINE.finditer(log):
+        event, time = m.group(1), int(m.group(2))
+        payload = int(m.group(3)) if m.group(3) else 0
+        energy = float(m.group(4)) if m.group(4) else 0.0
+        has_energy |= m.group(4) is not None
+        if first is None:
+            first = (time, energy)
+        if last is not None and not stack:
+            row = rows['OFF' if off else 'COMPUTE']
+            row['time'] += time - last[0]
+            row['energy'] += energy - last[1]
+        last = (time, energy)
+        off = False
+
+        name, _, edge = event.rpartition('_')
+        if name not in PHASES:
+            continue
+        if edge == 'BEGIN':
+            if name == 'BOOT' and stack:
+                # Power failed within these phases
+                for phase in stack:
+                    rows[phase.name]['cut'] += 1
+                rows['OFF']['time'] += time - stack[0].time
+                rows['OFF']['energy'] += energy - stack[0].energy
+                stack = []
+            stack.append(Phase(name, time, energy))
+        elif edge == 'END':
+            if not any(phase.name == name for phase in stack):
+                continue  # Started before the log
+            phase = stack.pop()
+            while phase.name != name:  # Ends missed, e.g. restore_yield()
+                phase = stack.pop()
+            inclusive = time - phase.time
+            inclusive_energy = energy - phase.energy
+            row = rows[name]
+            row['count'] += 1
+            row['inclusive'] += inclusive
+            row['time'] += inclusive - phase.child_time
+            row['energy'] += inclusive_energy - phase.child_energy
+            row['payload'] += payload
+            if stack:
+                stack[-1].child_time += inclusive
+                stack[-1].child_energy += inclusive_energy
+            elif name == 'SUSPEND':
+                off = True  # Until power is back
+
+    span = (last[0] - first[0], last[1] - first[1]) if last else (0, 0)
+    return rows, span, has_energy
+
+
+def print_breakdown(name, rows, span, has_energy):
+    print(name)
+    print('  {:12} {:>7} {:>5} {:>14} {:>6} {:>12} {:>12}{}'.format(
+        'phase', 'count', 'cut', 'time', 'share', 'mean', 'bytes',
+        ' {:>12} {:>6}'.format('energy [J]', 'share') if has_energy else ''))
+    for row_name in ROWS:
+        row = rows.get(row_name)
+        if not row:
+            continue
+        count = row['count']
+        line = '  {:12} {:>7} {:>5} {:14.0f} {:6.1%} {:>12} {:>12}'.format(
+            row_name.lower(), count if row_name in PHASES else '',
+            row['cut'] or '', row['time'],
+            row['time'] / span[0] if span[0] else 0,
+            '{:.0f}'.format(row['inclusive'] / count) if count else '',
+            row['payload'] or '')
+        if has_energy:
+            line += ' {:12.6g} {:6.1%}'.format(
+                row['energy'], row['energy'] / span[1] if span[1] else 0)
+        print(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+            formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('logs', nargs='+', help='logs with monitor events')
+    parser.add_argument('--csv', help='write the breakdowns to a CSV')
+    args = parser.parse_args()
+
+    results = []
+    for path in args.logs:
+        with open(path, errors='replace') as f:
+            rows, span, has_energy = breakdown(f.read())
+        if span[0] == 0:
+            print('{}: no monitor events'.format(path))
+            continue
+        print_breakdown(path, rows, span, has_energy)
+        for row_name in ROWS:
+            if row_name in rows:
+                row = rows[row_name]
+                results.append({
+                    'log': path, 'phase': row_name.lower(),
+                    'count': row['count'], 'cut': row['cut'],
+                    'time': row['time'], 'inclusive': row['inclusive'],
+                    'bytes': row['payload'],
+                    'energy': row['energy'] if has_energy else ''})
+
+    if args.csv:
+        with open(args.csv, 'w', newline='') as out:
+            writer = csv.DictWriter(out, fieldnames=[
+                'log', 'phase', 'count', 'cut', 'time', 'inclusive', 'bytes',
+                'energy'])
+            writer.writeheader()
+            writer.writerows(results)
+
+
+if __name__ == '__main__':
+    main()
@@ -41,6 +41,27 @@ void indicate_workload_end() {
 #endif
 }
 
+#if defined(SIMULATION) &&                                                     \
+    (MONITOR_RESERVED(SIMPLE_MONITOR_INDICATE_BEGIN) ||                        \
+     MONITOR_RESERVED(SIMPLE_MONITOR_INDICATE_END) ||                          \
+     MONITOR_RESERVED(SIMPLE_MONITOR_TEST_FAIL) ||                             \
+     MONITOR_RESERVED(SIMPLE_MONITOR_KILL_SIM))
+#error A SIMPLE_MONITOR code clashes with the codes reserved for phase events
+#endif
+
+void indicate_phase(monitor_phase_t event, uint32_t payload) {
+#ifdef SIMULATION
+  // The suspend may interrupt an event: keep the four words together
+  uint16_t gie = __get_SR_register() & GIE;
+  __bic_SR_register(GIE);
+  SIMPLE_MONITOR = MONITOR_PHASE;
+  SIMPLE_MONITOR = event;
+  SIMPLE_MONITOR = (uint16_t)payload;
+  SIMPLE_MONITOR = (uint16_t)(payload >> 16);
+  __bis_SR_register(gie);
+#endif
+}
+
 void end_experiment() {
 #ifdef SIMULATION
   SIMPLE_MONITOR = SIMPLE_MONITOR_KILL_SIM;
@@ -108,6 +129,15 @@ void disable_interrupt() { __bic_SR_register(GIE); }
 
 bool get_interrupt_enable() { return __get_SR_register() & GIE; }
 
+// TA0 counts SMCLK/8, i.e. 8-cycle resolution and a range of 2^19 cycles.
+// SMCLK stays at 8 MHz when DFS scales MCLK, so cycles are 8 MHz cycles
+// (MCLK cycles at the nominal clock): a measure of time, whatever the MCLK.
+void cycle_counter_start() {
+  TA0CTL = TASSEL__SMCLK | ID__8 | MC__CONTINUOUS | TACLR;
+}
+
+uint32_t cycle_counter_read() { return (uint32_t)TA0R << 3; }
+
 // Flush cache
 __attribute__((optimize(0))) void cache_flush() {
   // Fill cache with garbage
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019-2020, University of Southampton and Contributors.
+# All rights reserved.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+
+"""
+Replay supply traces through the host target's capacitor model, to compare
+forward progress of QR, AS and MS under the same energy conditions.
+
+`generate` writes a synthetic trace, one `<time [s]> <voltage [V]>
+<source resistance [ohm]>` per line:
+  periodic  square wave, e.g. a duty-cycled bench supply
+  solar     constant open-circuit voltage, source resistance following a
+            random irradiance (clouds)
+  rf        bursts from a weak, high impedance source
+
+`run` runs each host executable (<app>-<method>-host.elf) with every trace
+(ICLIB_SUPPLY_TRACE, see lib/iclib/host-ic.c) and writes a CSV with one row
+per app, method and trace:
+  progress       share of the replay spent on useful computation
+  wasted         run time lost to restarts after failed suspends [s]
+  e_checkpoint   energy spent on suspend and restore [uJ]
+MS bounds its dirty set by the energy left, so its suspends must never run
+out of energy: `run` fails if one does.
+
+Usage:
+  replay-supply-traces.py generate --kind solar --duration 10 -o solar.trace
+  replay-supply-traces.py run --build-dir build --traces *.trace -o replay.csv
+"""
+
+import argparse
+import csv
+import glob
+import os
+import random
+import re
+import subprocess
+import sys
+
+# Source resistance [ohm] of each kind of trace, unless given
+RESISTANCE = {'periodic': 100, 'solar': 300, 'rf': 3000}
+
+FIELDS = ['app', 'method', 'trace', 'done', 'time', 'on', 'off', 'wasted',
+          'progress', 'suspend_ok', 'suspend_fail', 'restore_ok',
+          'restore_fail', 'e_load', 'e_checkpoint']
+
+
+def generate(args):
+    rng = random.Random(args.seed)
+    if args.resistance is None:
+        args.resistance = RESISTANCE[args.kind]
+    samples = []
+    t = 0.0
+    if args.kind == 'periodic':
+        while t < args.duration:
+            samples.append((t, args.voltage, args.resistance))
+            samples.append((t + args.period * args.duty, 0.0,
+                            args.resistance))
+            t += args.period
+    elif args.kind == 'solar':
+        irradiance = 1.0
+        while t < args.duration:
+            irradiance += rng.gauss(0, 0.05)
+            irradiance = min(max(irradiance, 0.02), 1.0)
+            samples.append((t, args.voltage, args.resistance / irradiance))
+            t += 0.01
+    else:  # rf
+        while t < args.duration:
+            samples.append((t, args.voltage, args.resistance))
+            t += rng.expovariate(1 / (args.period * args.duty))
+            samples.append((t, 0.0, args.resistance))
+            t += rng.expovariate(1 / (args.period * (1 - args.duty)))
+    samples.append((max(t, args.duration), 0.0, args.resistance))  # End
+
+    with open(args.output, 'w') as out:
+        out.write('# {} trace, seed {}\n'.format(args.kind, args.seed))
+        for sample in samples:
+            out.write('{:.6f} {:.3f} {:.1f}\n'.format(*sample))
+
+
+def replay(elf, trace, args):
+    env = dict(os.environ, ICLIB_SUPPLY_TRACE=trace)
+    if args.time_scale:
+        env['ICLIB_TIME_SCALE'] = str(args.time_scale)
+    try:
+        result = subprocess.run([elf], env=env, stdout=subprocess.DEVNULL,
+                                stderr=subprocess.PIPE, timeout=args.timeout)
+        output = result.stderr.decode()
+    except subprocess.TimeoutExpired:
+        return None
+    m = re.search(r'^iclib-supply: (.*)$', output, re.MULTILINE)
+    if m is None:
+        return None
+    row = {}
+    for field in m.group(1).split():
+        key, value = field.split('=')
+        row[key] = float(value)
+    row['progress'] = (row['on'] - row['wasted']) / row['time']
+    row['e_load'] *= 1e6  # uJ
+    row['e_checkpoint'] *= 1e6
+    return row
+
+
+def run(args):
+    pattern = os.path.join(args.build_dir, 'apps', '*', '*-host.elf')
+    executables = []
+    for elf in sorted(glob.glob(pattern)):
+        m = re.match(r'(.*)-(QR|AS|MS)-host\.elf$', os.path.basename(elf))
+        if m and (not args.apps or m.group(1) in args.apps) \
+                and m.group(2) in args.methods:
+            executables.append((m.group(1), m.group(2), elf))
+    if not executables:
+        sys.exit('error: no host executables in {}'.format(args.build_dir))
+
+    rows = []
+    for trace in args.traces:
+        for app, method, elf in executables:
+            row = replay(elf, trace, args)
+            if row is None:
+                print('{} {} {}: no result'.format(app, method, trace))
+                continue
+            row.update(app=app, method=method,
+                       trace=os.path.basename(trace))
+            rows.append(row)
+            print('{:20} {:2} {:16} progress {:5.1%} wasted {:8.4f} s '
+                  'checkpoint {:10.1f} uJ{}'.format(
+                      app, method, row['trace'], row['progress'],
+                      row['wasted'], row['e_checkpoint'],
+                      '' if row['done'] else ' (stalled)'))
+
+    with open(args.output, 'w', newline='') as out:
+        writer = csv.DictWriter(out, fieldnames=FIELDS, extrasaction='ignore')
+        writer.writeheader()
+        writer.writerows(rows)
+
+    failed = ['{} {}'.format(row['app'], row['trace']) for row in rows
+              if row['method'] == 'MS' and row['suspend_fail'] > 0]
+    if failed:
+        sys.exit('error: MS suspends ran out of energy: {}'.format(
+            ', '.join(failed)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+            formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('command', choices=['generate', 'run'])
+    parser.add_argument('--kind', choices=['periodic', 'solar', 'rf'],
+                        default='periodic', help='synthetic trace')
+    parser.add_argument('--duration', type=float, default=10,
+                        help='trace length [s]')
+    parser.add_argument('--period', type=float, default=0.1,
+                        help='periodic: period, rf: mean burst interval [s]')
+    parser.add_argument('--duty', type=float, default=0.5,
+                        help='share of the period with the source on')
+    parser.add_argument('--voltage', type=float, default=3.6,
+                        help='open-circuit voltage [V]')
+    parser.add_argument('--resistance', type=float,
+                        help='source resistance [ohm]')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--build-dir', help='host build directory')
+    parser.add_argument('--traces', nargs='+', help='traces to replay')
+    parser.add_argument('--apps', nargs='*', help='apps (default all)')
+    parser.add_argument('--methods', nargs='+', default=['QR', 'AS', 'MS'])
+    parser.add_argument('--time-scale', type=float,
+                        help='device time per host time '
+                        '(default HOST_TIME_SCALE)')
+    parser.add_argument('--timeout', type=float, default=120,
+                        help='wall time limit per run [s]')
+    parser.add_argument('-o', '--output', required=True,
+                        help='trace or CSV file to write')
+    args = parser.parse_args()
+
+    if args.command == 'generate':
+        generate(args)
+    else:
+        if not args.build_dir or not args.traces:
+            parser.error('run needs --build-dir and --traces')
+        run(args)
+
+
+if __name__ == '__main__':
+    main()
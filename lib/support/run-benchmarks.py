@@ -0,0 +1,294 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019-2020, University of Southampton and Contributors.
+# All rights reserved.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+
+"""
+Run every <app>-<method>-<arch>.elf of one or more build directories and
+collect the results in a JSON and a CSV report, optionally compared against a
+baseline report.
+
+Each executable is run by a runner command, `{elf}` is replaced by its path.
+Host executables run directly. For other targets, give a runner for the
+simulator, e.g. `--runner "cm0=run-fused.sh {elf}"`. The runner must print the
+SIMPLE_MONITOR events on stdout or stderr in the same form as the host target:
+  iclib-monitor: <INDICATE_BEGIN|INDICATE_END|TEST_FAIL|KILL_SIM> <time>
+and may print the `iclib:` and `iclib-supply:` summary lines of host-ic.c.
+Monitor times are in ns on the host and in cycles in a simulator.
+
+Columns of the report:
+  status        ok, fail (TEST_FAIL or exit status), timeout or no-monitor
+  workload      median time between INDICATE_BEGIN and INDICATE_END
+  failures      power failures
+  suspend_bytes, restore_bytes  bytes checkpointed
+  bytes_per_failure             suspend_bytes / failures, steadier than the
+                                totals, as failures follow the wall clock
+  e_load, e_checkpoint          energy with --trace [uJ]
+  stress_*      failures injected at each stress point, with --stress
+  handler_ns    host time spent suspending and restoring
+  wasted_ns     host time lost to restores cut short, i.e. re-executed
+
+With --stress, the host target also fails at stress points in iclib (see
+ICLIB_STRESS in lib/iclib/host-ic.c), and each run uses another seed. The apps
+check their output against the reference, so a run that computes a wrong
+result fails.
+
+Usage:
+  run-benchmarks.py --build-dir build -o bench
+  run-benchmarks.py --build-dir build -o stress --stress 10 --fail-on-error
+  run-benchmarks.py --build-dir build -o bench --baseline baseline.json
+"""
+
+import argparse
+import csv
+import glob
+import json
+import os
+import re
+import shlex
+import statistics
+import subprocess
+import sys
+
+FIELDS = ['app', 'method', 'arch', 'status', 'workload', 'iterations',
+          'failures', 'suspend_bytes', 'restore_bytes', 'bytes_per_failure',
+          'suspend_ok',
+          'suspend_fail', 'restore_ok', 'restore_fail', 'e_load',
+          'e_checkpoint', 'stress_acquire', 'stress_writeback',
+          'stress_restore', 'handler_ns', 'wasted_ns']
+
+# Metrics compared against the baseline, higher is worse
+METRICS = ['workload', 'bytes_per_failure', 'e_checkpoint']
+
+
+def find_executables(args):
+    executables = []
+    for build_dir in args.build_dir:
+        pattern = os.path.join(build_dir, 'apps', '*', '*.elf')
+        for elf in sorted(glob.glob(pattern)):
+            m = re.match(r'(.*)-(QR|AS|MS)-(\w+)\.elf$', os.path.basename(elf))
+            if m and (not args.apps or m.group(1) in args.apps) \
+                    and m.group(2) in args.methods:
+                executables.append((m.group(1), m.group(2), m.group(3), elf))
+    return executables
+
+
+def parse(output):
+    """Parse the monitor events and summary lines of one run"""
+    result = {'events': [], 'workloads': []}
+    begin = None
+    for m in re.finditer(r'^iclib-monitor: (\w+) (\d+)', output, re.MULTILINE):
+        event, time = m.group(1), int(m.group(2))
+        result['events'].append(event)
+        if event == 'INDICATE_BEGIN':
+            begin = time
+        elif event == 'INDICATE_END' and begin is not None:
+            result['workloads'].append(time - begin)
+            begin = None
+
+    m = re.search(r'^iclib: (\d+) power failures, (\d+) bytes suspended, '
+                  r'(\d+) bytes restored', output, re.MULTILINE)
+    if m:
+        result['failures'] = int(m.group(1))
+        result['suspend_bytes'] = int(m.group(2))
+        result['restore_bytes'] = int(m.group(3))
+        if result['failures']:
+            result['bytes_per_failure'] = \
+                result['suspend_bytes'] / result['failures']
+    m = re.search(r'^iclib-supply: (.*)$', output, re.MULTILINE)
+    if m:
+        for field in m.group(1).split():
+            key, value = field.split('=')
+            result[key] = float(value)
+        result['e_load'] *= 1e6  # uJ
+        result['e_checkpoint'] *= 1e6
+    m = re.search(r'^iclib-stress: (.*)$', output, re.MULTILINE)
+    if m:
+        for field in m.group(1).split():
+            key, value = field.split('=')
+            if not key.endswith('_ns'):
+                key = 'stress_' + key
+            result[key] = int(value)
+    return result
+
+
+def run_once(elf, arch, seed, args):
+    runner = args.runners.get(arch)
+    if runner is None and arch != 'host':
+        return None
+    command = shlex.split(runner.format(elf=elf)) if runner else [elf]
+
+    env = dict(os.environ, ICLIB_MONITOR='1',
+               ICLIB_FAIL_US=str(args.fail_us),
+               ICLIB_FAIL_SEED=str(seed))
+    if args.trace:
+        env['ICLIB_SUPPLY_TRACE'] = args.trace
+    if args.stress:
+        env['ICLIB_STRESS'] = str(args.stress)
+    try:
+        proc = subprocess.run(command, env=env, stdout=subprocess.PIPE,
+                              stderr=subprocess.STDOUT, timeout=args.timeout)
+    except subprocess.TimeoutExpired:
+        return {'status': 'timeout'}
+
+    result = parse(proc.stdout.decode(errors='replace'))
+    if 'TEST_FAIL' in result['events'] or proc.returncode != 0:
+        result['status'] = 'fail'
+    elif not result['workloads']:
+        result['status'] = 'no-monitor'
+    else:
+        result['status'] = 'ok'
+    return result
+
+
+def benchmark(app, method, arch, elf, args):
+    """Run one executable args.repeat times, keep the median of each metric"""
+    runs = []
+    for i in range(args.repeat):
+        # Failures follow the wall clock anyway, except for stress points
+        seed = args.seed + i if args.stress else args.seed
+        result = run_once(elf, arch, seed, args)
+        if result is None:
+            return None
+        runs.append(result)
+        if result['status'] != 'ok':
+            break
+
+    row = {'app': app, 'method': method, 'arch': arch,
+           'status': runs[-1]['status']}
+    if args.stress:
+        row['seed'] = seed
+    if row['status'] != 'ok':
+        return row
+    row['iterations'] = len(runs[0]['workloads'])
+    row['workload'] = statistics.median(sum(r['workloads']) for r in runs)
+    for key in FIELDS[FIELDS.index('failures'):]:
+        values = [r[key] for r in runs if key in r]
+        if values:
+            row[key] = statistics.median(values)
+    return row
+
+
+def compare(rows, baseline, threshold):
+    """Print the differences against the baseline, return the regressions"""
+    key = lambda row: (row['app'], row['method'], row['arch'])
+    previous = {key(row): row for row in baseline}
+    regressions = []
+    for row in rows:
+        base = previous.get(key(row))
+        name = '{}-{}-{}'.format(*key(row))
+        if base is None:
+            print('{:30} new'.format(name))
+            continue
+        if row['status'] != base['status']:
+            print('{:30} status {} -> {}'.format(name, base['status'],
+                                                 row['status']))
+            if base['status'] == 'ok':
+                regressions.append(name)
+            continue
+        for metric in METRICS:
+            old, new = base.get(metric), row.get(metric)
+            if not old or new is None:
+                continue
+            change = (new - old) / old
+            if abs(change) > threshold:
+                print('{:30} {:17} {:+7.1%} ({:g} -> {:g})'.format(
+                    name, metric, change, old, new))
+                if change > 0:
+                    regressions.append(name)
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+            formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--build-dir', nargs='+', required=True,
+                        help='build directories, one per target')
+    parser.add_argument('--runner', action='append', default=[],
+                        metavar='ARCH=COMMAND',
+                        help='command that runs an executable of ARCH')
+    parser.add_argument('--apps', nargs='*', help='apps (default all)')
+    parser.add_argument('--methods', nargs='+', default=['QR', 'AS', 'MS'])
+    parser.add_argument('--repeat', type=int, default=5,
+                        help='runs per executable, the median is reported')
+    parser.add_argument('--fail-us', type=int, default=100,
+                        help='host: mean time between power failures [us]')
+    parser.add_argument('--seed', type=int, default=1,
+                        help='host: seed of the power failures')
+    parser.add_argument('--trace', help='host: supply trace to replay instead '
+                        'of random failures, adds energy to the report')
+    parser.add_argument('--stress', type=int,
+                        help='host: also fail at one in STRESS stress points')
+    parser.add_argument('--timeout', type=float, default=120,
+                        help='wall time limit per run [s]')
+    parser.add_argument('--baseline', help='JSON report to compare against')
+    parser.add_argument('--threshold', type=float, default=0.1,
+                        help='relative change reported as a difference')
+    parser.add_argument('--fail-on-regression', action='store_true',
+                        help='exit with an error on a regression')
+    parser.add_argument('--fail-on-error', action='store_true',
+                        help='exit with an error if a run fails')
+    parser.add_argument('-o', '--output', required=True,
+                        help='report to write, without extension')
+    args = parser.parse_args()
+
+    args.runners = {}
+    for runner in args.runner:
+        arch, _, command = runner.partition('=')
+        if not command:
+            parser.error('--runner needs ARCH=COMMAND')
+        args.runners[arch] = command
+
+    executables = find_executables(args)
+    if not executables:
+        sys.exit('error: no executables in {}'.format(
+            ' '.join(args.build_dir)))
+
+    rows = []
+    for app, method, arch, elf in executables:
+        row = benchmark(app, method, arch, elf, args)
+        if row is None:
+            print('{:20} {:2} {:6} skipped, no runner'.format(app, method,
+                                                             arch))
+            continue
+        rows.append(row)
+        if row['status'] == 'ok':
+            print('{:20} {:2} {:6} workload {:14.0f} failures {:6.0f} '
+                  'suspended {:10.0f} B{}'.format(
+                      app, method, arch, row['workload'],
+                      row.get('failures', 0), row.get('suspend_bytes', 0),
+                      ' wasted {:.0f} ns'.format(row['wasted_ns'])
+                      if 'wasted_ns' in row else ''))
+        else:
+            print('{:20} {:2} {:6} {}{}'.format(
+                app, method, arch, row['status'],
+                ' (seed {})'.format(row['seed']) if 'seed' in row else ''))
+
+    with open(args.output + '.json', 'w') as out:
+        json.dump(rows, out, indent=2)
+    with open(args.output + '.csv', 'w', newline='') as out:
+        writer = csv.DictWriter(out, fieldnames=FIELDS, extrasaction='ignore')
+        writer.writeheader()
+        writer.writerows(rows)
+
+    errors = [row for row in rows if row['status'] != 'ok']
+    if errors and args.fail_on_error:
+        sys.exit('error: {} executables failed'.format(len(errors)))
+
+    if args.baseline:
+        if not os.path.exists(args.baseline):
+            print('no baseline {}'.format(args.baseline))
+            return
+        with open(args.baseline) as f:
+            regressions = compare(rows, json.load(f), args.threshold)
+        print('{} regressions against {}'.format(len(regressions),
+                                                 args.baseline))
+        if regressions and args.fail_on_regression:
+            sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
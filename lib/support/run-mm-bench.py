@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2019-2020, University of Southampton and Contributors.
+# All rights reserved.
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+
+"""
+Run the memory manager microbenchmarks (apps/mm-bench), one executable per
+PAGE_SIZE/MAX_DIRTY_PAGES configuration, and collect their results in a CSV.
+
+Host executables run directly, without power failures. For other targets,
+give a runner, `{elf}` is replaced by the path of the executable, e.g.
+`--runner "run-fused.sh {elf}"`. It must print the result table (`results` in
+apps/mm-bench/main.c) in the same form as the host target, one line per row:
+  mm-bench: page_size=128 max_dirty=8 api=acquire pattern=seq pages=4 ...
+
+Columns of the CSV:
+  api, pattern, pages, write_pct   what was measured, pages is the working
+                                   set and write_pct the share of writes
+  calls                            timed calls
+  cycles_per_call                  cycles, ns on the host
+  bytes_per_call                   bytes loaded from and written to NVM
+  threshold_updates                calls to ic_update_thresholds()
+
+Usage:
+  run-mm-bench.py --build-dir build -o mm-bench.csv
+  run-mm-bench.py --build-dir build -o mm-bench.csv --configs 128x8 128x20
+"""
+
+import argparse
+import csv
+import glob
+import os
+import re
+import shlex
+import subprocess
+import sys
+
+FIELDS = ['page_size', 'max_dirty', 'api', 'pattern', 'pages', 'write_pct',
+          'calls', 'cycles_per_call', 'bytes_per_call', 'threshold_updates']
+
+
+def find_executables(args):
+    pattern = os.path.join(args.build_dir, 'apps', 'mm-bench', '*.elf')
+    executables = []
+    for elf in sorted(glob.glob(pattern)):
+        m = re.match(r'mm-bench-(\d+x\d+)-\w+\.elf$', os.path.basename(elf))
+        if m and (not args.configs or m.group(1) in args.configs):
+            executables.append((m.group(1), elf))
+    return executables
+
+
+def run(elf, args):
+    command = shlex.split(args.runner.format(elf=elf)) if args.runner \
+        else [elf]
+    env = dict(os.environ, ICLIB_FAIL_US='0')
+    try:
+        # The iclib summary on stderr would interleave with the table
+        proc = subprocess.run(command, env=env, stdout=subprocess.PIPE,
+                              stderr=subprocess.DEVNULL, timeout=args.timeout)
+    except subprocess.TimeoutExpired:
+        return None
+
+    rows = []
+    for m in re.finditer(r'^mm-bench: (.*)$', proc.stdout.decode(
+            errors='replace'), re.MULTILINE):
+        row = dict(field.split('=') for field in m.group(1).split())
+        calls = int(row['calls'])
+        if calls:
+            row['cycles_per_call'] = int(row['cycles']) / calls
+            row['bytes_per_call'] = int(row['bytes']) / calls
+        rows.append(row)
+    return rows
+
+
+def summary(rows):
+    """Print the mean cycles per call of each API, per configuration"""
+    configs = sorted({(int(r['page_size']), int(r['max_dirty']))
+                      for r in rows})
+    apis = []
+    for r in rows:
+        if r['api'] not in apis:
+            apis.append(r['api'])
+
+    print('{:14}'.format('cycles/call') +
+          ''.join('{:>10}'.format('{}x{}'.format(*c)) for c in configs))
+    for api in apis:
+        line = '{:14}'.format(api)
+        for page_size, max_dirty in configs:
+            values = [r['cycles_per_call'] for r in rows
+                      if r['api'] == api and 'cycles_per_call' in r and
+                      int(r['page_size']) == page_size and
+                      int(r['max_dirty']) == max_dirty]
+            line += '{:10.0f}'.format(sum(values) / len(values)) \
+                if values else '{:>10}'.format('-')
+        print(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+            formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--build-dir', required=True, help='build directory')
+    parser.add_argument('--runner', help='command that runs an executable')
+    parser.add_argument('--configs', nargs='*',
+                        help='configurations, e.g. 128x20 (default all)')
+    parser.add_argument('--timeout', type=float, default=120,
+                        help='wall time limit per run [s]')
+    parser.add_argument('-o', '--output', required=True, help='CSV to write')
+    args = parser.parse_args()
+
+    executables = find_executables(args)
+    if not executables:
+        sys.exit('error: no mm-bench executables in {}'.format(
+            args.build_dir))
+
+    rows = []
+    for config, elf in executables:
+        result = run(elf, args)
+        if not result:
+            print('{:10} no result'.format(config))
+            continue
+        rows += result
+
+    with open(args.output, 'w', newline='') as out:
+        writer = csv.DictWriter(out, fieldnames=FIELDS, extrasaction='ignore')
+        writer.writeheader()
+        writer.writerows(rows)
+    if rows:
+        summary(rows)
+
+
+if __name__ == '__main__':
+    main()
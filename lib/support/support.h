@@ -17,10 +17,39 @@
 #define TARGE_WORD uint16_t
 #include <msp430fr5994.h>
 #include "lib/support/msp430-support.h"
+#elif defined(HOST_ARCH)
+#define TARGET_WORD uintptr_t
+#include "lib/support/host-support.h"
 #else
 #error Target architecture must be defined
 #endif
 
+//! SIMPLE_MONITOR codes from MONITOR_PHASE to MONITOR_PHASE + 0xFF are
+//! reserved for the phase events: the Fused codes must stay out of this range
+//! (checked by the targets). A phase event is written as four 16-bit words,
+//! with interrupts masked: MONITOR_PHASE, the event code, then the low and
+//! high halves of the payload. The runner takes the three words after
+//! MONITOR_PHASE as data, whatever their value.
+#define MONITOR_PHASE 0xF100
+#define MONITOR_RESERVED(code) (((code) & 0xFF00) == MONITOR_PHASE)
+
+//! Extended monitor events, at the boundaries of the iclib phases (ic_phase_t,
+//! in the same order). Payloads are in bytes, 0 where not counted.
+typedef enum {
+  MONITOR_BOOT_BEGIN = MONITOR_PHASE + 0x10,
+  MONITOR_BOOT_END,
+  MONITOR_RESTORE_BEGIN,
+  MONITOR_RESTORE_END, //! Bytes restored (host)
+  MONITOR_SUSPEND_BEGIN,
+  MONITOR_SUSPEND_END, //! Bytes saved
+  MONITOR_FLUSH_BEGIN,
+  MONITOR_FLUSH_END, //! Bytes written back by mm_flush()
+  MONITOR_THRESHOLDS_BEGIN,
+  MONITOR_THRESHOLDS_END, //! Bytes to suspend
+  MONITOR_CHECKPOINT_BEGIN,
+  MONITOR_CHECKPOINT_END, //! Bytes saved by ic_checkpoint()
+} monitor_phase_t;
+
 // ------ Target functions ------
 
 // Initialize target
@@ -38,6 +67,9 @@ void indicate_workload_end();
 // Indicate test fail
 void indicate_test_fail();
 
+// Indicate a phase boundary of iclib, with a payload (see monitor_phase_t)
+void indicate_phase(monitor_phase_t event, uint32_t payload);
+
 // End experiment
 void end_experiment();
 
@@ -56,6 +88,13 @@ void assert_keep_alive();
 // De-assert KeepAlive
 void deassert_keep_alive();
 
+// Start (and reset) cycle counter
+void cycle_counter_start();
+
+// Read number of cycles since cycle_counter_start(). On msp430 these are
+// SMCLK cycles (8 MHz), which DFS does not scale
+uint32_t cycle_counter_read();
+
 // ------ Functions that must be implemented by benchmarks ------
 
 /**